@@ -2,6 +2,8 @@
 #include <cassert>
 #include <future>
 #include <map>
+#include <mutex>
+#include <optional>
 #include <string>
 #include <vector>
 
@@ -33,6 +35,24 @@ public:
         return Access{buckets_[bucket_index], key, vm_[bucket_index]};
     }
 
+    // Значение по ключу без вставки значения по умолчанию
+    std::optional<Value> Find(const Key &key) const {
+        const size_t bucket_index = static_cast<size_t>(key) % buckets_.size();
+        std::lock_guard guard(vm_[bucket_index]);
+        const auto it = buckets_[bucket_index].find(key);
+        if (it == buckets_[bucket_index].end()) {
+            return std::nullopt;
+        }
+        return it->second;
+    }
+
+    // Возвращает false, если ключа не было
+    bool Erase(const Key &key) {
+        const size_t bucket_index = static_cast<size_t>(key) % buckets_.size();
+        std::lock_guard guard(vm_[bucket_index]);
+        return buckets_[bucket_index].erase(key) > 0;
+    }
+
     std::map<Key, Value> BuildOrdinaryMap() {
         std::map<Key, Value> ordinary_map;
         for (size_t i = 0; i < buckets_.size(); ++i) {
@@ -45,5 +65,5 @@ public:
 
 private:
     std::vector<std::map<Key, Value>> buckets_;
-    std::vector<std::mutex> vm_;
+    mutable std::vector<std::mutex> vm_;
 };
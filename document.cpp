@@ -4,8 +4,8 @@ using namespace std;
 
 Document::Document(int id, double relevance, int rating)
     : id(id)
-    , relevance(relevance)
-    , rating(rating) {
+    , rating(rating)
+    , relevance(relevance) {
 }
 
 ostream& operator<<(ostream& out, const Document& document) {
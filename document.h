@@ -1,6 +1,7 @@
 #pragma once
 
 #include <ostream>
+#include <string_view>
 
 enum class DocumentStatus {
     ACTUAL,
@@ -9,13 +10,23 @@ enum class DocumentStatus {
     REMOVED,
 };
 
+// Поля упорядочены так, чтобы два int занимали место перед double без выравнивающих дыр:
+// при выгрузке миллионов результатов запись в 16 байт вместо 24 экономит треть памяти и трафика
 struct Document {
     Document() = default;
     Document(int id, double relevance, int rating);
 
     int id = 0;
-    double relevance = 0.0;
     int rating = 0;
+    double relevance = 0.0;
+};
+
+static_assert(sizeof(Document) == 16, "Document must stay packed into 16 bytes");
+
+// Именованное поле документа: заголовок, текст, теги. Поле "body" хранится как обычный текст документа
+struct DocumentField {
+    std::string_view name;
+    std::string_view text;
 };
 
 std::ostream& operator<<(std::ostream& out, const Document& document);
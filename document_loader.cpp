@@ -0,0 +1,536 @@
+#include "document_loader.h"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cerrno>
+#include <charconv>
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <exception>
+#include <limits>
+#include <map>
+#include <mutex>
+#include <optional>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace std;
+
+MappedFile::MappedFile(const std::string& path) {
+    const int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        throw runtime_error("Cannot open "s + path + ": "s + strerror(errno));
+    }
+    struct stat file_stat{};
+    if (fstat(fd, &file_stat) != 0) {
+        const int error = errno;
+        close(fd);
+        throw runtime_error("Cannot stat "s + path + ": "s + strerror(error));
+    }
+    size_ = static_cast<size_t>(file_stat.st_size);
+    if (size_ > 0) {
+        void* const data = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (data == MAP_FAILED) {
+            const int error = errno;
+            close(fd);
+            throw runtime_error("Cannot map "s + path + ": "s + strerror(error));
+        }
+        // Файл читается один раз от начала к концу
+        madvise(data, size_, MADV_SEQUENTIAL);
+        data_ = static_cast<const char*>(data);
+    }
+    close(fd);
+}
+
+MappedFile::~MappedFile() {
+    if (data_) {
+        munmap(const_cast<char*>(data_), size_);
+    }
+}
+
+namespace {
+const size_t CHUNK_SIZE = 4 * 1024 * 1024;
+
+struct ParsedDocument {
+    int id = 0;
+    DocumentStatus status = DocumentStatus::ACTUAL;
+    vector<int> ratings;
+    vector<string_view> words;
+    uint64_t fingerprint = 0;
+    size_t line = 0;
+};
+
+// Документы одного блока. Тексты с escape-последовательностями JSON декодируются в owned_texts,
+// остальные слова указывают прямо в отображённый файл
+struct ParsedChunk {
+    vector<ParsedDocument> documents;
+    deque<string> owned_texts;
+    size_t errors = 0;
+    string first_error;
+    size_t first_error_line = 0;
+};
+
+optional<DocumentStatus> ParseStatus(string_view text) {
+    if (text == "ACTUAL"sv || text == "0"sv) {
+        return DocumentStatus::ACTUAL;
+    }
+    if (text == "IRRELEVANT"sv || text == "1"sv) {
+        return DocumentStatus::IRRELEVANT;
+    }
+    if (text == "BANNED"sv || text == "2"sv) {
+        return DocumentStatus::BANNED;
+    }
+    if (text == "REMOVED"sv || text == "3"sv) {
+        return DocumentStatus::REMOVED;
+    }
+    return nullopt;
+}
+
+bool ParseInt(string_view text, int& value) {
+    const auto result = from_chars(text.data(), text.data() + text.size(), value);
+    return result.ec == errc() && result.ptr == text.data() + text.size();
+}
+
+bool ParseRatings(string_view text, vector<int>& ratings) {
+    size_t pos = 0;
+    while (pos < text.size()) {
+        const size_t start = text.find_first_not_of(", "sv, pos);
+        if (start == string_view::npos) {
+            break;
+        }
+        const size_t end = min(text.find_first_of(", "sv, start), text.size());
+        int rating = 0;
+        if (!ParseInt(text.substr(start, end - start), rating)) {
+            return false;
+        }
+        ratings.push_back(rating);
+        pos = end;
+    }
+    return true;
+}
+
+string_view ParseTsvLine(string_view line, ParsedDocument& document) {
+    array<string_view, 3> fields;
+    for (auto& field: fields) {
+        const size_t tab = line.find('\t');
+        if (tab == string_view::npos) {
+            throw invalid_argument("expected 4 tab-separated fields"s);
+        }
+        field = line.substr(0, tab);
+        line.remove_prefix(tab + 1);
+    }
+    if (!ParseInt(fields[0], document.id)) {
+        throw invalid_argument("invalid id"s);
+    }
+    const auto status = ParseStatus(fields[1]);
+    if (!status) {
+        throw invalid_argument("invalid status"s);
+    }
+    document.status = *status;
+    if (!ParseRatings(fields[2], document.ratings)) {
+        throw invalid_argument("invalid ratings"s);
+    }
+    return line;
+}
+
+// Минимальный разбор плоского JSON-объекта с полями id, status, ratings, text
+class JsonLineParser {
+public:
+    JsonLineParser(string_view line, deque<string>& owned_texts)
+            : line_(line), owned_texts_(owned_texts) {
+    }
+
+    string_view Parse(ParsedDocument& document) {
+        string_view text;
+        bool has_id = false;
+        bool has_text = false;
+        Expect('{');
+        SkipSpaces();
+        if (Peek() == '}') {
+            throw invalid_argument("empty object"s);
+        }
+        while (true) {
+            const string_view key = ParseString();
+            Expect(':');
+            SkipSpaces();
+            if (key == "id"sv) {
+                has_id = ParseInt(ParseNumber(), document.id);
+                if (!has_id) {
+                    throw invalid_argument("invalid id"s);
+                }
+            } else if (key == "status"sv) {
+                const auto status = ParseStatus(Peek() == '"' ? ParseString() : ParseNumber());
+                if (!status) {
+                    throw invalid_argument("invalid status"s);
+                }
+                document.status = *status;
+            } else if (key == "ratings"sv) {
+                ParseRatingsArray(document.ratings);
+            } else if (key == "text"sv) {
+                text = ParseString();
+                has_text = true;
+            } else {
+                SkipValue();
+            }
+            SkipSpaces();
+            if (Peek() == ',') {
+                ++pos_;
+                continue;
+            }
+            Expect('}');
+            break;
+        }
+        if (!has_id || !has_text) {
+            throw invalid_argument("id and text are required"s);
+        }
+        return text;
+    }
+
+private:
+    string_view line_;
+    size_t pos_ = 0;
+    deque<string>& owned_texts_;
+
+    void SkipSpaces() {
+        while (pos_ < line_.size() && (line_[pos_] == ' ' || line_[pos_] == '\t')) {
+            ++pos_;
+        }
+    }
+
+    char Peek() {
+        if (pos_ >= line_.size()) {
+            throw invalid_argument("unexpected end of line"s);
+        }
+        return line_[pos_];
+    }
+
+    void Expect(char c) {
+        SkipSpaces();
+        if (Peek() != c) {
+            throw invalid_argument("expected '"s + c + "'"s);
+        }
+        ++pos_;
+    }
+
+    string_view ParseNumber() {
+        const size_t start = pos_;
+        while (pos_ < line_.size() && (line_[pos_] == '-' || (line_[pos_] >= '0' && line_[pos_] <= '9'))) {
+            ++pos_;
+        }
+        return line_.substr(start, pos_ - start);
+    }
+
+    // Строка без escape-последовательностей возвращается как view в исходные байты
+    string_view ParseString() {
+        Expect('"');
+        const size_t start = pos_;
+        const size_t end = line_.find_first_of("\"\\"sv, pos_);
+        if (end == string_view::npos) {
+            throw invalid_argument("unterminated string"s);
+        }
+        if (line_[end] == '"') {
+            pos_ = end + 1;
+            return line_.substr(start, end - start);
+        }
+        string& decoded = owned_texts_.emplace_back(line_.substr(start, end - start));
+        pos_ = end;
+        while (Peek() != '"') {
+            const char c = line_[pos_++];
+            if (c != '\\') {
+                decoded.push_back(c);
+                continue;
+            }
+            const char escaped = Peek();
+            ++pos_;
+            switch (escaped) {
+                case 'n':
+                case 't':
+                case 'r':
+                    decoded.push_back(' ');
+                    break;
+                case 'b':
+                case 'f':
+                    break;
+                case 'u':
+                    AppendCodePoint(decoded);
+                    break;
+                default:
+                    decoded.push_back(escaped);
+            }
+        }
+        ++pos_;
+        return decoded;
+    }
+
+    void AppendCodePoint(string& out) {
+        if (pos_ + 4 > line_.size()) {
+            throw invalid_argument("invalid \\u escape"s);
+        }
+        unsigned code = 0;
+        const auto result = from_chars(line_.data() + pos_, line_.data() + pos_ + 4, code, 16);
+        if (result.ptr != line_.data() + pos_ + 4) {
+            throw invalid_argument("invalid \\u escape"s);
+        }
+        pos_ += 4;
+        if (code < 0x20) {
+            out.push_back(' ');
+        } else if (code < 0x80) {
+            out.push_back(static_cast<char>(code));
+        } else if (code < 0x800) {
+            out.push_back(static_cast<char>(0xC0 | (code >> 6)));
+            out.push_back(static_cast<char>(0x80 | (code & 0x3F)));
+        } else {
+            out.push_back(static_cast<char>(0xE0 | (code >> 12)));
+            out.push_back(static_cast<char>(0x80 | ((code >> 6) & 0x3F)));
+            out.push_back(static_cast<char>(0x80 | (code & 0x3F)));
+        }
+    }
+
+    void ParseRatingsArray(vector<int>& ratings) {
+        Expect('[');
+        SkipSpaces();
+        if (Peek() == ']') {
+            ++pos_;
+            return;
+        }
+        while (true) {
+            SkipSpaces();
+            int rating = 0;
+            if (!ParseInt(ParseNumber(), rating)) {
+                throw invalid_argument("invalid rating"s);
+            }
+            ratings.push_back(rating);
+            SkipSpaces();
+            if (Peek() == ',') {
+                ++pos_;
+                continue;
+            }
+            Expect(']');
+            return;
+        }
+    }
+
+    void SkipValue() {
+        SkipSpaces();
+        const char c = Peek();
+        if (c == '"') {
+            ParseString();
+        } else if (c == '[' || c == '{') {
+            // Вложенные значения пропускаются по балансу скобок, строки внутри разбираются целиком
+            int depth = 0;
+            do {
+                const char current = Peek();
+                if (current == '"') {
+                    ParseString();
+                    continue;
+                }
+                if (current == '[' || current == '{') {
+                    ++depth;
+                } else if (current == ']' || current == '}') {
+                    --depth;
+                }
+                ++pos_;
+            } while (depth > 0);
+        } else {
+            while (pos_ < line_.size() && line_[pos_] != ',' && line_[pos_] != '}') {
+                ++pos_;
+            }
+        }
+    }
+};
+
+ParsedChunk ParseChunk(const SearchServer& search_server, string_view chunk, size_t first_line, CorpusFormat format) {
+    ParsedChunk result;
+    size_t line_number = first_line;
+    const bool compute_fingerprints = search_server.GetDuplicatePolicy() != DuplicatePolicy::ALLOW;
+    while (!chunk.empty()) {
+        const size_t end = min(chunk.find('\n'), chunk.size());
+        string_view line = chunk.substr(0, end);
+        chunk.remove_prefix(min(end + 1, chunk.size()));
+        ++line_number;
+        if (!line.empty() && line.back() == '\r') {
+            line.remove_suffix(1);
+        }
+        if (line.empty()) {
+            continue;
+        }
+        ParsedDocument document;
+        document.line = line_number;
+        try {
+            const string_view text = format == CorpusFormat::TSV
+                                     ? ParseTsvLine(line, document)
+                                     : JsonLineParser(line, result.owned_texts).Parse(document);
+            document.words = search_server.Tokenize(text);
+            if (compute_fingerprints) {
+                document.fingerprint = ComputeTermSetFingerprint(document.words);
+            }
+            result.documents.push_back(move(document));
+        } catch (const invalid_argument& e) {
+            if (result.errors++ == 0) {
+                result.first_error = "line "s + to_string(line_number) + ": "s + e.what();
+                result.first_error_line = line_number;
+            }
+        }
+    }
+    return result;
+}
+
+struct Chunk {
+    string_view data;
+    size_t first_line;
+};
+
+vector<Chunk> SplitIntoChunks(string_view data) {
+    vector<Chunk> chunks;
+    size_t line = 0;
+    while (!data.empty()) {
+        size_t end = min(CHUNK_SIZE, data.size());
+        if (end < data.size()) {
+            const size_t newline = data.find('\n', end);
+            end = newline == string_view::npos ? data.size() : newline + 1;
+        }
+        const string_view chunk = data.substr(0, end);
+        chunks.push_back({chunk, line});
+        line += static_cast<size_t>(count(chunk.begin(), chunk.end(), '\n'));
+        data.remove_prefix(end);
+    }
+    return chunks;
+}
+}
+
+LoadStats LoadDocuments(SearchServer& search_server, std::string_view data, CorpusFormat format, size_t parser_threads) {
+    const vector<Chunk> chunks = SplitIntoChunks(data);
+    parser_threads = max<size_t>(1, min(parser_threads, chunks.size()));
+    // Сколько разобранных блоков может ждать индексации: ограничивает память при медленном индексаторе
+    const size_t max_ready_chunks = 2 * parser_threads;
+
+    mutex m;
+    condition_variable chunk_ready;
+    condition_variable chunk_consumed;
+    map<size_t, ParsedChunk> ready_chunks;
+    size_t next_to_index = 0;
+    atomic<size_t> next_to_parse{0};
+    bool stopped = false;
+    // Исключение разбора, кроме invalid_argument для отдельной строки (например, bad_alloc):
+    // из std::thread оно вызвало бы std::terminate, поэтому передаётся индексирующему потоку
+    exception_ptr parse_error;
+
+    const auto parse = [&] {
+        try {
+            while (true) {
+                const size_t index = next_to_parse.fetch_add(1);
+                if (index >= chunks.size()) {
+                    return;
+                }
+                {
+                    unique_lock lock(m);
+                    chunk_consumed.wait(lock, [&] { return stopped || index < next_to_index + max_ready_chunks; });
+                    if (stopped) {
+                        return;
+                    }
+                }
+                ParsedChunk parsed = ParseChunk(search_server, chunks[index].data, chunks[index].first_line, format);
+                {
+                    lock_guard guard(m);
+                    ready_chunks.emplace(index, move(parsed));
+                }
+                chunk_ready.notify_all();
+            }
+        } catch (...) {
+            {
+                lock_guard guard(m);
+                if (!parse_error) {
+                    parse_error = current_exception();
+                }
+                stopped = true;
+            }
+            chunk_ready.notify_all();
+            chunk_consumed.notify_all();
+        }
+    };
+
+    vector<thread> parsers;
+    parsers.reserve(parser_threads);
+    for (size_t i = 0; i < parser_threads; ++i) {
+        parsers.emplace_back(parse);
+    }
+
+    LoadStats stats;
+    stats.bytes = data.size();
+    const bool compute_fingerprints = search_server.GetDuplicatePolicy() != DuplicatePolicy::ALLOW;
+    try {
+        for (; next_to_index < chunks.size();) {
+            ParsedChunk parsed;
+            {
+                unique_lock lock(m);
+                chunk_ready.wait(lock, [&] { return parse_error || ready_chunks.count(next_to_index) > 0; });
+                if (parse_error) {
+                    rethrow_exception(parse_error);
+                }
+                parsed = move(ready_chunks.at(next_to_index));
+                ready_chunks.erase(next_to_index);
+            }
+            // Ошибки разбора и индексации одного блока идут в отчёт по порядку строк
+            string chunk_error = move(parsed.first_error);
+            size_t chunk_error_line = parsed.errors > 0 ? parsed.first_error_line : numeric_limits<size_t>::max();
+            for (const ParsedDocument& document: parsed.documents) {
+                try {
+                    const auto duplicate = search_server.AddTokenizedDocument(
+                            document.id, document.words, document.status, document.ratings,
+                            compute_fingerprints ? optional{document.fingerprint} : nullopt);
+                    if (duplicate) {
+                        ++stats.duplicates;
+                    }
+                    if (!duplicate || search_server.GetDuplicatePolicy() == DuplicatePolicy::REPLACE) {
+                        ++stats.documents;
+                    }
+                } catch (const invalid_argument& e) {
+                    ++stats.errors;
+                    if (document.line < chunk_error_line) {
+                        chunk_error = "line "s + to_string(document.line) + ": "s + e.what();
+                        chunk_error_line = document.line;
+                    }
+                }
+            }
+            if (stats.first_error.empty()) {
+                stats.first_error = move(chunk_error);
+            }
+            stats.errors += parsed.errors;
+            {
+                lock_guard guard(m);
+                ++next_to_index;
+            }
+            chunk_consumed.notify_all();
+        }
+    } catch (...) {
+        {
+            lock_guard guard(m);
+            stopped = true;
+        }
+        chunk_consumed.notify_all();
+        for (auto& parser: parsers) {
+            parser.join();
+        }
+        throw;
+    }
+
+    for (auto& parser: parsers) {
+        parser.join();
+    }
+    search_server.RefreshInverseDocumentFreqs();
+    return stats;
+}
+
+LoadStats LoadDocumentsFromFile(SearchServer& search_server, const std::string& path, CorpusFormat format,
+                                size_t parser_threads) {
+    const MappedFile file(path);
+    return LoadDocuments(search_server, file.GetData(), format, parser_threads);
+}
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <string>
+#include <string_view>
+#include <thread>
+
+#include "search_server.h"
+
+// Файл, отображённый в память только для чтения
+class MappedFile {
+public:
+    explicit MappedFile(const std::string &path);
+
+    MappedFile(const MappedFile &) = delete;
+
+    MappedFile &operator=(const MappedFile &) = delete;
+
+    ~MappedFile();
+
+    [[nodiscard]] std::string_view GetData() const {
+        return {data_, size_};
+    }
+
+private:
+    const char *data_ = nullptr;
+    size_t size_ = 0;
+};
+
+enum class CorpusFormat {
+    // id<TAB>status<TAB>ratings<TAB>text, рейтинги через запятую или пробел, статус — имя или число
+    TSV,
+    // {"id": 1, "status": "ACTUAL", "ratings": [1, 2], "text": "..."} в каждой строке
+    JSONL,
+};
+
+struct LoadStats {
+    size_t documents = 0;
+    size_t errors = 0;
+    // Документы, совпавшие с уже загруженными (см. SearchServer::SetDuplicatePolicy): пропущенные при KEEP_FIRST
+    // и заменившие старые при REPLACE. При REJECT дубликаты считаются ошибками
+    size_t duplicates = 0;
+    size_t bytes = 0;
+    // Первая ошибка с номером строки, остальные только подсчитываются
+    std::string first_error;
+};
+
+// Потоковая загрузка корпуса: файл отображается в память и режется на блоки по границам строк,
+// parser_threads потоков разбирают блоки и делят тексты на слова прямо из отображённых байтов,
+// а вызывающий поток добавляет готовые документы в индекс в порядке следования в файле.
+// Отпечатки для поиска дубликатов тоже считаются в потоках разбора.
+// Некорректные строки пропускаются и учитываются в LoadStats::errors
+LoadStats LoadDocumentsFromFile(SearchServer &search_server, const std::string &path, CorpusFormat format,
+                                size_t parser_threads = std::max(1u, std::thread::hardware_concurrency()));
+
+// То же для корпуса, уже находящегося в памяти
+LoadStats LoadDocuments(SearchServer &search_server, std::string_view data, CorpusFormat format,
+                        size_t parser_threads = std::max(1u, std::thread::hardware_concurrency()));
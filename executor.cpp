@@ -0,0 +1,45 @@
+#include "executor.h"
+
+using namespace std;
+
+ThreadPoolExecutor::ThreadPoolExecutor(size_t thread_count) {
+    threads_.reserve(thread_count);
+    for (size_t i = 0; i < thread_count; ++i) {
+        threads_.emplace_back([this] { Work(); });
+    }
+}
+
+ThreadPoolExecutor::~ThreadPoolExecutor() {
+    {
+        lock_guard guard(m_);
+        stopping_ = true;
+    }
+    ready_.notify_all();
+    for (auto &thread: threads_) {
+        thread.join();
+    }
+}
+
+void ThreadPoolExecutor::Post(std::coroutine_handle<> handle) {
+    {
+        lock_guard guard(m_);
+        queue_.push_back(handle);
+    }
+    ready_.notify_one();
+}
+
+void ThreadPoolExecutor::Work() {
+    while (true) {
+        coroutine_handle<> handle;
+        {
+            unique_lock lock(m_);
+            ready_.wait(lock, [this] { return stopping_ || !queue_.empty(); });
+            if (queue_.empty()) {
+                return;
+            }
+            handle = queue_.front();
+            queue_.pop_front();
+        }
+        handle.resume();
+    }
+}
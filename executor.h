@@ -0,0 +1,64 @@
+#pragma once
+
+#include <algorithm>
+#include <condition_variable>
+#include <coroutine>
+#include <cstddef>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Исполнитель, на котором возобновляются асинхронные запросы
+class Executor {
+public:
+    virtual ~Executor() = default;
+
+    // Ставит корутину в очередь; возобновлять её нужно на одном из потоков исполнителя
+    virtual void Post(std::coroutine_handle<> handle) = 0;
+};
+
+// co_await Schedule(executor) переносит корутину в очередь исполнителя. Повторный вызов внутри длинной
+// корутины уступает потоки задачам, которые ждут в очереди
+inline auto Schedule(Executor &executor) {
+    struct Awaiter {
+        Executor &executor;
+
+        bool await_ready() noexcept {
+            return false;
+        }
+
+        void await_suspend(std::coroutine_handle<> handle) {
+            executor.Post(handle);
+        }
+
+        void await_resume() noexcept {
+        }
+    };
+    return Awaiter{executor};
+}
+
+// Пул потоков с общей FIFO-очередью: уступившая корутина встаёт в конец и пропускает вперёд
+// запросы, пришедшие раньше её следующего шага
+class ThreadPoolExecutor : public Executor {
+public:
+    explicit ThreadPoolExecutor(size_t thread_count = std::max(1u, std::thread::hardware_concurrency()));
+
+    ThreadPoolExecutor(const ThreadPoolExecutor &) = delete;
+
+    ThreadPoolExecutor &operator=(const ThreadPoolExecutor &) = delete;
+
+    // Дожидается опустошения очереди
+    ~ThreadPoolExecutor() override;
+
+    void Post(std::coroutine_handle<> handle) override;
+
+private:
+    std::mutex m_;
+    std::condition_variable ready_;
+    std::deque<std::coroutine_handle<>> queue_;
+    bool stopping_ = false;
+    std::vector<std::thread> threads_;
+
+    void Work();
+};
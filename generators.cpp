@@ -0,0 +1,100 @@
+#include "generators.h"
+
+#include <algorithm>
+#include <cmath>
+#include <set>
+
+using namespace std;
+
+string GenerateWord(mt19937& generator, int max_length) {
+    const int length = uniform_int_distribution(1, max_length)(generator);
+    string word;
+    word.reserve(length);
+    for (int i = 0; i < length; ++i) {
+        word.push_back(uniform_int_distribution<>('a', 'z')(generator));
+    }
+    return word;
+}
+
+vector<string> GenerateDictionary(mt19937& generator, int word_count, int max_length) {
+    vector<string> words;
+    words.reserve(word_count);
+    for (int i = 0; i < word_count; ++i) {
+        words.push_back(GenerateWord(generator, max_length));
+    }
+    words.erase(unique(words.begin(), words.end()), words.end());
+    return words;
+}
+
+vector<string> GenerateVocabulary(mt19937& generator, int word_count, int max_length) {
+    set<string> seen;
+    vector<string> words;
+    words.reserve(word_count);
+    while (static_cast<int>(words.size()) < word_count) {
+        string word = GenerateWord(generator, max_length);
+        if (seen.insert(word).second) {
+            words.push_back(move(word));
+        }
+    }
+    return words;
+}
+
+string GenerateQuery(mt19937& generator, const vector<string>& dictionary, int word_count, double minus_prob) {
+    string query;
+    for (int i = 0; i < word_count; ++i) {
+        if (!query.empty()) {
+            query.push_back(' ');
+        }
+        if (uniform_real_distribution<>(0, 1)(generator) < minus_prob) {
+            query.push_back('-');
+        }
+        query += dictionary[uniform_int_distribution<int>(0, dictionary.size() - 1)(generator)];
+    }
+    return query;
+}
+
+vector<string> GenerateQueries(mt19937& generator, const vector<string>& dictionary, int query_count, int max_word_count) {
+    vector<string> queries;
+    queries.reserve(query_count);
+    for (int i = 0; i < query_count; ++i) {
+        queries.push_back(GenerateQuery(generator, dictionary, max_word_count));
+    }
+    return queries;
+}
+
+ZipfWordGenerator::ZipfWordGenerator(const vector<string>& dictionary, double exponent)
+        : dictionary_(dictionary) {
+    vector<double> weights(dictionary.size());
+    for (size_t rank = 0; rank < weights.size(); ++rank) {
+        weights[rank] = 1.0 / pow(static_cast<double>(rank + 1), exponent);
+    }
+    distribution_ = discrete_distribution<size_t>(weights.begin(), weights.end());
+}
+
+const string& ZipfWordGenerator::operator()(mt19937& generator) {
+    return dictionary_[distribution_(generator)];
+}
+
+string GenerateZipfText(mt19937& generator, ZipfWordGenerator& words, int word_count, double minus_prob) {
+    string text;
+    for (int i = 0; i < word_count; ++i) {
+        if (!text.empty()) {
+            text.push_back(' ');
+        }
+        if (minus_prob > 0 && uniform_real_distribution<>(0, 1)(generator) < minus_prob) {
+            text.push_back('-');
+        }
+        text += words(generator);
+    }
+    return text;
+}
+
+vector<string> GenerateZipfTexts(mt19937& generator, ZipfWordGenerator& words, int text_count, int word_count,
+                                 double minus_prob) {
+    vector<string> texts;
+    texts.reserve(text_count);
+    for (int i = 0; i < text_count; ++i) {
+        texts.push_back(GenerateZipfText(generator, words, word_count, minus_prob));
+    }
+    return texts;
+}
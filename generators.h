@@ -0,0 +1,38 @@
+#pragma once
+
+#include <random>
+#include <string>
+#include <vector>
+
+// Генераторы синтетических словарей, документов и запросов для нагрузочных проверок
+
+std::string GenerateWord(std::mt19937 &generator, int max_length);
+
+std::vector<std::string> GenerateDictionary(std::mt19937 &generator, int word_count, int max_length);
+
+// В отличие от GenerateDictionary возвращает ровно word_count различных слов
+std::vector<std::string> GenerateVocabulary(std::mt19937 &generator, int word_count, int max_length);
+
+std::string GenerateQuery(std::mt19937 &generator, const std::vector<std::string> &dictionary, int word_count,
+                          double minus_prob = 0);
+
+std::vector<std::string> GenerateQueries(std::mt19937 &generator, const std::vector<std::string> &dictionary,
+                                         int query_count, int max_word_count);
+
+// Слово с рангом k выбирается с вероятностью, пропорциональной 1 / k^exponent
+class ZipfWordGenerator {
+public:
+    ZipfWordGenerator(const std::vector<std::string> &dictionary, double exponent);
+
+    const std::string &operator()(std::mt19937 &generator);
+
+private:
+    const std::vector<std::string> &dictionary_;
+    std::discrete_distribution<size_t> distribution_;
+};
+
+std::string GenerateZipfText(std::mt19937 &generator, ZipfWordGenerator &words, int word_count,
+                             double minus_prob = 0);
+
+std::vector<std::string> GenerateZipfTexts(std::mt19937 &generator, ZipfWordGenerator &words, int text_count,
+                                           int word_count, double minus_prob = 0);
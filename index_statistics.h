@@ -0,0 +1,50 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+// Статистика одного слова словаря, по которой планируется порядок вычисления запроса
+struct TermStatistics {
+    size_t document_freq = 0;
+    double inverse_document_freq = 0.0;
+    double max_term_freq = 0.0;
+    // Наибольшая частота в каждом блоке из POSTING_BLOCK_SIZE записей списка. Вместе с IDF и весом слова
+    // ограничивает сверху его вклад в релевантность любого документа блока
+    std::vector<double> block_max_term_freqs;
+};
+
+// Распределение слов словаря по частотам
+struct IndexStatistics {
+    size_t term_count = 0;
+    size_t postings_count = 0;
+    size_t max_document_freq = 0;
+    // document_freq_histogram[i] — число слов, встречающихся в [2^i, 2^(i+1)) документах
+    std::vector<size_t> document_freq_histogram;
+    // max_term_freq_histogram[i] — число слов, наибольшая частота которых в документе лежит в (2^-(i+1), 2^-i]
+    std::vector<size_t> max_term_freq_histogram;
+};
+
+// Результат SearchServer::Verify
+struct IndexVerificationResult {
+    // Первые нарушения согласованности структур индекса, не больше MAX_REPORTED_ERRORS
+    std::vector<std::string> errors;
+    size_t error_count = 0;
+    // Не ошибки, а то, что освободит Compact: пустые списки документов и слова словаря без списков
+    size_t empty_posting_lists = 0;
+    size_t orphan_terms = 0;
+
+    static constexpr size_t MAX_REPORTED_ERRORS = 16;
+
+    [[nodiscard]] bool IsConsistent() const {
+        return error_count == 0;
+    }
+};
+
+// Результат SearchServer::Compact
+struct CompactionStats {
+    size_t removed_posting_lists = 0;
+    size_t removed_terms = 0;
+    // Разница GetMemoryStats().total_bytes до и после сжатия: точная при SEARCH_SERVER_MEMORY_ACCOUNTING, иначе оценка
+    size_t reclaimed_bytes = 0;
+};
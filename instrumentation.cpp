@@ -0,0 +1,202 @@
+#include "instrumentation.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <fstream>
+#include <mutex>
+#include <stdexcept>
+#include <vector>
+
+using namespace std;
+
+namespace {
+// Пишет только поток-владелец, поэтому хватает relaxed load/store без атомарных RMW
+struct ThreadCounters {
+    array<atomic<uint64_t>, TRACE_STAGE_COUNT> calls{};
+    array<atomic<uint64_t>, TRACE_STAGE_COUNT> total_ns{};
+    array<atomic<uint64_t>, TRACE_STAGE_COUNT> max_ns{};
+};
+
+class Registry {
+public:
+    void Register(ThreadCounters* counters) {
+        lock_guard guard(mutex_);
+        threads_.push_back(counters);
+    }
+
+    // Счётчики завершившегося потока складываются в общий итог, чтобы список потоков не рос
+    // в процессах, которые создают потоки на каждую загрузку или пакет запросов
+    void Retire(ThreadCounters* counters) {
+        lock_guard guard(mutex_);
+        for (size_t i = 0; i < TRACE_STAGE_COUNT; ++i) {
+            auto& stage = retired_[i];
+            stage.calls += counters->calls[i].load(memory_order_relaxed);
+            stage.total_ns += counters->total_ns[i].load(memory_order_relaxed);
+            stage.max_ns = max(stage.max_ns, counters->max_ns[i].load(memory_order_relaxed));
+        }
+        threads_.erase(find(threads_.begin(), threads_.end(), counters));
+    }
+
+    InstrumentationSnapshot Snapshot() {
+        InstrumentationSnapshot snapshot;
+        lock_guard guard(mutex_);
+        snapshot.stages = retired_;
+        snapshot.thread_count = threads_.size();
+        for (const ThreadCounters* counters: threads_) {
+            for (size_t i = 0; i < TRACE_STAGE_COUNT; ++i) {
+                auto& stage = snapshot.stages[i];
+                stage.calls += counters->calls[i].load(memory_order_relaxed);
+                stage.total_ns += counters->total_ns[i].load(memory_order_relaxed);
+                stage.max_ns = max(stage.max_ns, counters->max_ns[i].load(memory_order_relaxed));
+            }
+        }
+        return snapshot;
+    }
+
+    void Reset() {
+        lock_guard guard(mutex_);
+        retired_ = {};
+        for (ThreadCounters* counters: threads_) {
+            for (size_t i = 0; i < TRACE_STAGE_COUNT; ++i) {
+                counters->calls[i].store(0, memory_order_relaxed);
+                counters->total_ns[i].store(0, memory_order_relaxed);
+                counters->max_ns[i].store(0, memory_order_relaxed);
+            }
+        }
+    }
+
+private:
+    mutex mutex_;
+    vector<ThreadCounters*> threads_;
+    array<StageStats, TRACE_STAGE_COUNT> retired_{};
+};
+
+Registry& GetRegistry() {
+    // Не разрушается: потоки пула могут завершаться уже после деструкторов статических объектов
+    static Registry* const registry = new Registry;
+    return *registry;
+}
+
+// Регистрирует счётчики потока при первом замере и снимает их с учёта при завершении потока
+struct ThreadCountersHolder {
+    ThreadCounters counters;
+
+    ThreadCountersHolder() {
+        GetRegistry().Register(&counters);
+    }
+
+    ThreadCountersHolder(const ThreadCountersHolder&) = delete;
+
+    ThreadCountersHolder& operator=(const ThreadCountersHolder&) = delete;
+
+    ~ThreadCountersHolder() {
+        GetRegistry().Retire(&counters);
+    }
+};
+
+ThreadCounters& GetThreadCounters() {
+    // Регистрация под мьютексом происходит один раз на поток
+    thread_local ThreadCountersHolder holder;
+    return holder.counters;
+}
+
+QueryTrace& GetThreadQueryTrace() {
+    thread_local QueryTrace trace{};
+    return trace;
+}
+
+void Add(atomic<uint64_t>& counter, uint64_t value) {
+    counter.store(counter.load(memory_order_relaxed) + value, memory_order_relaxed);
+}
+}
+
+const char* GetTraceStageName(TraceStage stage) {
+    switch (stage) {
+        case TraceStage::PARSE:
+            return "parse";
+        case TraceStage::CANDIDATES:
+            return "candidates";
+        case TraceStage::SCORING:
+            return "scoring";
+        case TraceStage::TOP_K:
+            return "top_k";
+        case TraceStage::MATCH_DOCUMENT:
+            return "match_document";
+        case TraceStage::ADD_DOCUMENT:
+            return "add_document";
+        case TraceStage::REMOVE_DOCUMENT:
+            return "remove_document";
+        default:
+            return "unknown";
+    }
+}
+
+void RecordStage(TraceStage stage, std::chrono::nanoseconds duration) {
+    const auto index = static_cast<size_t>(stage);
+    const auto duration_ns = static_cast<uint64_t>(duration.count());
+    ThreadCounters& counters = GetThreadCounters();
+    Add(counters.calls[index], 1);
+    Add(counters.total_ns[index], duration_ns);
+    if (counters.max_ns[index].load(memory_order_relaxed) < duration_ns) {
+        counters.max_ns[index].store(duration_ns, memory_order_relaxed);
+    }
+    GetThreadQueryTrace()[index] += duration_ns;
+}
+
+void BeginQueryTrace() {
+    GetThreadQueryTrace().fill(0);
+}
+
+const QueryTrace& GetLastQueryTrace() {
+    return GetThreadQueryTrace();
+}
+
+InstrumentationSnapshot GetInstrumentationSnapshot() {
+    return GetRegistry().Snapshot();
+}
+
+void ResetInstrumentation() {
+    GetRegistry().Reset();
+}
+
+void ExportInstrumentation(std::ostream& out, ExportFormat format) {
+    const auto snapshot = GetInstrumentationSnapshot();
+    if (format == ExportFormat::PROMETHEUS) {
+        const auto write_metric = [&out, &snapshot](const char* name, const char* type, auto field) {
+            out << "# TYPE "s << name << ' ' << type << '\n';
+            for (size_t i = 0; i < TRACE_STAGE_COUNT; ++i) {
+                out << name << "{stage=\""s << GetTraceStageName(static_cast<TraceStage>(i)) << "\"} "s
+                    << snapshot.stages[i].*field << '\n';
+            }
+        };
+        write_metric("search_server_stage_calls_total", "counter", &StageStats::calls);
+        write_metric("search_server_stage_duration_nanoseconds_total", "counter", &StageStats::total_ns);
+        write_metric("search_server_stage_duration_nanoseconds_max", "gauge", &StageStats::max_ns);
+        return;
+    }
+
+    out << "{\"threads\": "s << snapshot.thread_count << ", \"stages\": {"s;
+    for (size_t i = 0; i < TRACE_STAGE_COUNT; ++i) {
+        const auto& stage = snapshot.stages[i];
+        out << (i ? ", "s : ""s) << '"' << GetTraceStageName(static_cast<TraceStage>(i)) << "\": {"s
+            << "\"calls\": "s << stage.calls << ", "s
+            << "\"total_ns\": "s << stage.total_ns << ", "s
+            << "\"max_ns\": "s << stage.max_ns << '}';
+    }
+    out << "}}"s << '\n';
+}
+
+void DumpInstrumentation(const std::string& path, ExportFormat format) {
+    const string temporary_path = path + ".tmp"s;
+    {
+        ofstream out(temporary_path, ios::trunc);
+        if (!out) {
+            throw runtime_error("Cannot open "s + temporary_path);
+        }
+        ExportInstrumentation(out, format);
+    }
+    if (rename(temporary_path.c_str(), path.c_str()) != 0) {
+        throw runtime_error("Cannot replace "s + path);
+    }
+}
@@ -0,0 +1,91 @@
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <ostream>
+#include <string>
+
+// Счётчики этапов обработки запросов. Каждый поток копит свои значения без блокировок,
+// снимок суммирует потоки. При сборке без SEARCH_SERVER_INSTRUMENTATION таймеры ничего не делают
+
+enum class TraceStage {
+    PARSE,
+    CANDIDATES,
+    SCORING,
+    TOP_K,
+    MATCH_DOCUMENT,
+    ADD_DOCUMENT,
+    REMOVE_DOCUMENT,
+    COUNT,
+};
+
+const size_t TRACE_STAGE_COUNT = static_cast<size_t>(TraceStage::COUNT);
+
+const char *GetTraceStageName(TraceStage stage);
+
+struct StageStats {
+    uint64_t calls = 0;
+    uint64_t total_ns = 0;
+    uint64_t max_ns = 0;
+};
+
+struct InstrumentationSnapshot {
+    std::array<StageStats, TRACE_STAGE_COUNT> stages;
+    size_t thread_count = 0;
+};
+
+// Длительности этапов последнего запроса, выполненного текущим потоком
+using QueryTrace = std::array<uint64_t, TRACE_STAGE_COUNT>;
+
+enum class ExportFormat {
+    PROMETHEUS,
+    JSON,
+};
+
+void RecordStage(TraceStage stage, std::chrono::nanoseconds duration);
+
+// Обнуляет трассу текущего потока перед новым запросом
+void BeginQueryTrace();
+
+const QueryTrace &GetLastQueryTrace();
+
+InstrumentationSnapshot GetInstrumentationSnapshot();
+
+void ResetInstrumentation();
+
+void ExportInstrumentation(std::ostream &out, ExportFormat format);
+
+// Пишет снимок во временный файл и переименовывает его, чтобы читатель не увидел файл наполовину
+void DumpInstrumentation(const std::string &path, ExportFormat format);
+
+class StageTimer {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    explicit StageTimer(TraceStage stage)
+            : stage_(stage) {
+    }
+
+    StageTimer(const StageTimer &) = delete;
+
+    StageTimer &operator=(const StageTimer &) = delete;
+
+    ~StageTimer() {
+        RecordStage(stage_, Clock::now() - start_time_);
+    }
+
+private:
+    const TraceStage stage_;
+    const Clock::time_point start_time_ = Clock::now();
+};
+
+#ifdef SEARCH_SERVER_INSTRUMENTATION
+#define TRACE_CONCAT_INTERNAL(X, Y) X##Y
+#define TRACE_CONCAT(X, Y) TRACE_CONCAT_INTERNAL(X, Y)
+#define TRACE_STAGE(stage) StageTimer TRACE_CONCAT(traceGuard, __LINE__)(TraceStage::stage)
+#define TRACE_QUERY_BEGIN() BeginQueryTrace()
+#else
+#define TRACE_STAGE(stage) static_cast<void>(0)
+#define TRACE_QUERY_BEGIN() static_cast<void>(0)
+#endif
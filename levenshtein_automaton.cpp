@@ -0,0 +1,31 @@
+#include "levenshtein_automaton.h"
+
+#include <algorithm>
+
+using namespace std;
+
+LevenshteinAutomaton::LevenshteinAutomaton(std::string_view word, int max_edits)
+        : word_(word), max_edits_(max_edits) {
+}
+
+LevenshteinAutomaton::State LevenshteinAutomaton::Start() const {
+    State state(word_.size() + 1);
+    for (size_t i = 0; i < state.size(); ++i) {
+        state[i] = static_cast<int>(i);
+    }
+    return state;
+}
+
+LevenshteinAutomaton::State LevenshteinAutomaton::Step(const State& state, char c) const {
+    State next(state.size());
+    next[0] = state[0] + 1;
+    for (size_t i = 1; i < state.size(); ++i) {
+        const int replace_cost = state[i - 1] + (word_[i - 1] == c ? 0 : 1);
+        next[i] = min({replace_cost, state[i] + 1, next[i - 1] + 1});
+    }
+    return next;
+}
+
+bool LevenshteinAutomaton::CanMatch(const State& state) const {
+    return *min_element(state.begin(), state.end()) <= max_edits_;
+}
@@ -0,0 +1,86 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Автомат Левенштейна для слова: состояние — строка матрицы редакционного расстояния
+// после прочитанного префикса кандидата
+class LevenshteinAutomaton {
+public:
+    using State = std::vector<int>;
+
+    LevenshteinAutomaton(std::string_view word, int max_edits);
+
+    [[nodiscard]] State Start() const;
+
+    [[nodiscard]] State Step(const State &state, char c) const;
+
+    // Прочитанный кандидат находится на расстоянии не больше max_edits
+    [[nodiscard]] bool IsMatch(const State &state) const {
+        return state.back() <= max_edits_;
+    }
+
+    // Какое-то продолжение прочитанного префикса ещё может подойти
+    [[nodiscard]] bool CanMatch(const State &state) const;
+
+    [[nodiscard]] int Distance(const State &state) const {
+        return state.back();
+    }
+
+private:
+    std::string_view word_;
+    int max_edits_;
+};
+
+// Обход упорядоченного словаря автоматом: общий с предыдущим словом префикс не пересчитывается,
+// а если префикс уже не может подойти, все слова с ним пропускаются одним lower_bound.
+// max_steps ограничивает число переходов автомата, чтобы исправление укладывалось в бюджет времени
+template<typename SortedDictionary, typename Callback>
+void ForEachFuzzyMatch(const SortedDictionary &dictionary, const LevenshteinAutomaton &automaton,
+                       size_t max_steps, Callback callback) {
+    std::vector<LevenshteinAutomaton::State> states{automaton.Start()};
+    std::string_view previous;
+    size_t steps = 0;
+    auto it = dictionary.begin();
+    while (it != dictionary.end()) {
+        const std::string_view word = it->first;
+        const size_t limit = std::min(std::min(previous.size(), word.size()), states.size() - 1);
+        size_t common = 0;
+        while (common < limit && previous[common] == word[common]) {
+            ++common;
+        }
+        states.resize(common + 1);
+        previous = word;
+
+        bool pruned = false;
+        for (size_t i = common; i < word.size(); ++i) {
+            if (++steps > max_steps) {
+                return;
+            }
+            states.push_back(automaton.Step(states.back(), word[i]));
+            if (!automaton.CanMatch(states.back())) {
+                std::string next_prefix{word.substr(0, i + 1)};
+                while (!next_prefix.empty() && static_cast<unsigned char>(next_prefix.back()) == 0xFF) {
+                    next_prefix.pop_back();
+                }
+                if (next_prefix.empty()) {
+                    return;
+                }
+                ++next_prefix.back();
+                it = dictionary.lower_bound(std::string_view{next_prefix});
+                pruned = true;
+                break;
+            }
+        }
+        if (pruned) {
+            continue;
+        }
+        if (automaton.IsMatch(states.back())) {
+            callback(*it, automaton.Distance(states.back()));
+        }
+        ++it;
+    }
+}
@@ -4,13 +4,18 @@
 //#include "remove_duplicates.h"
 #include "paginator.h"
 #include "process_queries.h"
+#include "document_loader.h"
+#include "numa_search_pool.h"
+#include "write_ahead_log.h"
+#include "ranking.h"
 
 #include <iostream>
 #include <string>
 #include <vector>
 #include <execution>
-
-#include "test_parallel_work.h"
+#include <filesystem>
+#include <random>
+#include <thread>
 
 using namespace std;
 
@@ -231,6 +236,502 @@ void Test6() {
 
 }
 
+void Test7() {
+    SearchServer search_server("and with"s);
+
+    int id = 0;
+    for (
+        const string &text : {
+            "white cat and yellow hat"s,
+            "curly cat curly tail"s,
+            "catfish with big eyes"s,
+            "nasty category john"s,
+    }
+            ) {
+        search_server.AddDocument(++id, text, DocumentStatus::ACTUAL, {1, 2});
+    }
+
+    // префиксный поиск: cat* подставляет cat, catfish и category
+    for (const Document &document : search_server.FindTopDocuments("cat* -nasty"s)) {
+        PrintDocument(document);
+    }
+
+    search_server.SetMaxPrefixExpansion(1);
+    cout << search_server.FindTopDocuments("cat*"s).size() << " documents for query [cat*] with one expansion"s << endl;
+}
+
+void Test8() {
+    SearchServer search_server("and with"s);
+    search_server.SetPositionalIndex(true);
+
+    int id = 0;
+    for (
+        const string &text : {
+            "white cat and yellow hat"s,
+            "yellow cat with white tail"s,
+            "white dog and yellow bird"s,
+    }
+            ) {
+        search_server.AddDocument(++id, text, DocumentStatus::ACTUAL, {1, 2});
+    }
+
+    cout << "Phrase [\"white cat\"]:"s << endl;
+    for (const Document &document : search_server.FindTopDocuments("\"white cat\""s)) {
+        PrintDocument(document);
+    }
+    cout << "Proximity [white NEAR/2 tail]:"s << endl;
+    for (const Document &document : search_server.FindTopDocuments("white NEAR/2 tail"s)) {
+        PrintDocument(document);
+    }
+    const auto[words, status] = search_server.MatchDocument("\"yellow cat\" hat"s, 2);
+    cout << words.size() << " words for document 2"s << endl;
+}
+
+void Test9() {
+    SearchServer search_server("and with"s);
+    search_server.SetFuzzyMatching(2);
+
+    int id = 0;
+    for (
+        const string &text : {
+            "fluffy cat with long tail"s,
+            "curly dog and fancy collar"s,
+            "fluffy dog"s,
+    }
+            ) {
+        search_server.AddDocument(++id, text, DocumentStatus::ACTUAL, {1, 2});
+    }
+
+    // опечатки исправляются по словарю, исправленные слова весят меньше точных
+    for (const Document &document : search_server.FindTopDocuments("fluffi colar"s)) {
+        PrintDocument(document);
+    }
+}
+
+void Test10() {
+    SearchServer search_server("and with"s);
+
+    int id = 0;
+    for (
+        const string &text : {
+            "funny pet and nasty rat"s,
+            "funny pet with curly hair"s,
+            "nasty rat with curly hair"s,
+    }
+            ) {
+        search_server.AddDocument(++id, text, DocumentStatus::ACTUAL, {1, 2});
+    }
+
+    // длительность этапов последнего запроса и накопленные счётчики
+    cout << search_server.FindTopDocuments("curly nasty -funny"s).size() << " documents found"s << endl;
+    const auto &trace = GetLastQueryTrace();
+    for (size_t stage = 0; stage < TRACE_STAGE_COUNT; ++stage) {
+        if (trace[stage]) {
+            cout << GetTraceStageName(static_cast<TraceStage>(stage)) << ": "s << trace[stage] << " ns"s << endl;
+        }
+    }
+    ExportInstrumentation(cout, ExportFormat::JSON);
+}
+
+void Test11() {
+    SearchServer search_server("and with"s);
+
+    int id = 0;
+    for (
+        const string &text : {
+            "funny pet and nasty rat"s,
+            "funny pet with curly hair"s,
+            "nasty rat with curly hair"s,
+    }
+            ) {
+        search_server.AddDocument(++id, text, DocumentStatus::ACTUAL, {1, 2});
+    }
+
+    const IndexMemoryStats stats = search_server.GetMemoryStats();
+    cout << stats.total_bytes << " bytes for "s << stats.vocabulary_size << " words and "s
+         << stats.postings_count << " postings"s << endl;
+    ExportMemoryStats(cout, stats, ExportFormat::PROMETHEUS);
+}
+
+void Test12() {
+    SearchServer search_server("and with"s);
+
+    // корпус в формате JSONL; вторая строка с ошибкой пропускается
+    const string corpus =
+            "{\"id\": 1, \"status\": \"ACTUAL\", \"ratings\": [7, 2, 7], \"text\": \"funny pet and nasty rat\"}\n"s
+            "{\"id\": 2, \"ratings\": [1, 2]}\n"s
+            "{\"id\": 3, \"ratings\": [1, 2], \"text\": \"nasty rat with curly\\thair\"}\n"s;
+    const LoadStats stats = LoadDocuments(search_server, corpus, CorpusFormat::JSONL);
+    cout << stats.documents << " documents loaded, "s << stats.errors << " errors ("s << stats.first_error << ")"s
+         << endl;
+    for (const Document &document : search_server.FindTopDocuments("curly rat"s)) {
+        PrintDocument(document);
+    }
+}
+
+void Test13() {
+    SearchServer search_server("and with"s);
+
+    int id = 0;
+    for (
+        const string &text : {
+            "white cat and yellow hat"s,
+            "curly cat curly tail"s,
+            "nasty dog with big eyes"s,
+            "nasty pigeon john"s,
+    }
+            ) {
+        search_server.AddDocument(++id, text, DocumentStatus::ACTUAL, {1, 2});
+    }
+
+    // асинхронная версия: запрос выполняется на потоках пула, SyncWait ждёт результат
+    ThreadPoolExecutor executor(2);
+    for (const Document &document : SyncWait(search_server.FindTopDocumentsAsync(executor, "curly nasty cat"s))) {
+        PrintDocument(document);
+    }
+}
+
+void Test14() {
+    SearchServer search_server("and with"s);
+
+    int id = 0;
+    for (
+        const string &text : {
+            "funny pet and nasty rat"s,
+            "funny pet with curly hair"s,
+            "funny pet and not very nasty rat"s,
+            "pet with rat and rat and rat"s,
+            "nasty rat with curly hair"s,
+    }
+            ) {
+        search_server.AddDocument(++id, text, DocumentStatus::ACTUAL, {1, 2});
+    }
+
+    // бюджет в 3 записи списков: подсчёт обрывается, результат помечается как частичный
+    QueryBudget budget;
+    budget.max_postings = 3;
+    const vector<string> queries = {
+            "curly hair"s,
+            "funny nasty pet rat"s,
+    };
+    id = 0;
+    for (const TopDocumentsResult &result : ProcessQueries(search_server, queries, budget)) {
+        cout << result.documents.size() << " documents for query ["s << queries[id++] << "]"s
+             << (result.partial ? " (partial)"s : ""s) << endl;
+    }
+}
+
+void Test15() {
+    // таблица стоп-слов строится при компиляции
+    constexpr StaticStopWords stop_words(std::array{"and"sv, "with"sv});
+    static_assert(stop_words.Contains("with"sv) && !stop_words.Contains("cat"sv));
+    SearchServer search_server(stop_words);
+
+    search_server.AddDocument(1, "white cat and yellow hat"s, DocumentStatus::ACTUAL, {1, 2});
+    cout << search_server.GetWordFrequencies(1).size() << " words for document 1"s << endl;
+}
+
+void Test16() {
+    SearchServer search_server("and with"s);
+    search_server.SetFieldWeight("title"sv, 3.0);
+
+    search_server.AddDocument(1, {{"title"sv, "curly cat"sv}, {"body"sv, "white cat and fashionable collar"sv}},
+                              DocumentStatus::ACTUAL, {8, -3});
+    search_server.AddDocument(2, {{"title"sv, "fluffy dog"sv}, {"body"sv, "curly cat and expressive eyes"sv},
+                                  {"tags"sv, "pets"sv}},
+                              DocumentStatus::ACTUAL, {7, 2, 7});
+
+    // совпадение в заголовке весит втрое больше, а title:curly ищет только по заголовку.
+    // title^0 выключает заголовок: документ 1, где curly есть только в нём, не находится
+    for (const string &query : {"curly"s, "title:curly"s, "curly title^0"s}) {
+        cout << "Query ["s << query << "]:"s << endl;
+        for (const Document &document : search_server.FindTopDocuments(query)) {
+            PrintDocument(document);
+        }
+    }
+}
+
+void Test17() {
+    SearchServer search_server("and with"s);
+    // дубликат отбрасывается при добавлении, отдельный проход RemoveDuplicates не нужен
+    search_server.SetDuplicatePolicy(DuplicatePolicy::KEEP_FIRST);
+
+    search_server.AddDocument(1, "funny pet and nasty rat"s, DocumentStatus::ACTUAL, {7, 2, 7});
+    search_server.AddDocument(2, "nasty rat and funny pet and pet"s, DocumentStatus::ACTUAL, {1, 2});
+    search_server.AddDocument(3, "funny pet with curly hair"s, DocumentStatus::ACTUAL, {1, 2});
+    cout << search_server.GetDocumentCount() << " documents after ingest"s << endl;
+}
+
+void Test18() {
+    SearchServer search_server("and with"s);
+
+    int id = 0;
+    for (
+        const string &text : {
+            "funny pet and nasty rat"s,
+            "funny pet with curly hair"s,
+            "funny pet and not very nasty rat"s,
+            "pet with rat and rat and rat"s,
+            "nasty rat with curly hair"s,
+    }
+            ) {
+        search_server.AddDocument(++id, text, DocumentStatus::ACTUAL, {1, 2});
+    }
+
+    // по статистике планировщик начинает с редких слов, а частые минус-слова проверяет только у кандидатов
+    for (const string_view word : {"rat"sv, "curly"sv}) {
+        const auto stats = search_server.GetTermStatistics(word);
+        cout << word << ": document_freq = "s << stats->document_freq << ", max_term_freq = "s << stats->max_term_freq
+             << endl;
+    }
+    const IndexStatistics stats = search_server.GetIndexStatistics();
+    cout << stats.term_count << " terms, document_freq_histogram ="s;
+    for (const size_t count : stats.document_freq_histogram) {
+        cout << ' ' << count;
+    }
+    cout << endl;
+    cout << search_server.FindTopDocuments("curly -rat"s).size() << " documents for query [curly -rat]"s << endl;
+}
+
+void Test19() {
+    SearchServer search_server("and with"s);
+
+    int id = 0;
+    for (
+        const string &text : {
+            "funny pet and nasty rat"s,
+            "funny pet with curly hair"s,
+            "funny pet and not very nasty rat"s,
+            "pet with rat and rat and rat"s,
+            "nasty rat with curly hair"s,
+    }
+            ) {
+        search_server.AddDocument(++id, text, DocumentStatus::ACTUAL, {1, 2});
+    }
+
+    // MATCH/ALL требует все слова, MATCH/2 — любые два
+    for (const string &query : {"funny nasty rat"s, "MATCH/ALL funny nasty rat"s, "MATCH/2 curly nasty funny"s}) {
+        cout << search_server.FindTopDocuments(query).size() << " documents for query ["s << query << "]"s << endl;
+    }
+}
+
+void Test20() {
+    // два узла моделируются на любой машине; на реальной топологию даёт ReadNumaTopology()
+    NumaSearchPool pool(SimulateNumaTopology(2), [] {
+        SearchServer search_server("and with"s);
+        search_server.AddDocument(1, "funny pet and nasty rat"s, DocumentStatus::ACTUAL, {7, 2, 7});
+        search_server.AddDocument(2, "funny pet with curly hair"s, DocumentStatus::ACTUAL, {1, 2});
+        return search_server;
+    }, 1);
+
+    const vector<string> queries = {"nasty rat"s, "curly hair"s, "funny pet"s};
+    const auto results = pool.ProcessQueries(queries);
+    size_t total = 0;
+    for (const NumaNodeStats &stats : pool.GetNodeStats()) {
+        total += stats.queries;
+    }
+    cout << results.size() << " results from "s << pool.GetNodeCount() << " replicas, "s << total
+         << " queries in node stats"s << endl;
+}
+
+void Test21() {
+    SearchServer search_server("and with"s);
+    search_server.AddDocument(1, "funny pet and nasty rat"s, DocumentStatus::ACTUAL, {7, 2, 7});
+    search_server.AddDocument(2, "funny pet with curly hair"s, DocumentStatus::ACTUAL, {1, 2});
+    search_server.RemoveDocument(1);
+
+    // после удаления остались пустые списки и слова nasty, rat; сжатие их убирает
+    const IndexVerificationResult before = search_server.Verify();
+    const CompactionStats compaction = search_server.Compact();
+    const IndexVerificationResult after = search_server.Verify();
+    cout << "consistent: "s << before.IsConsistent() << ", orphan terms: "s << before.orphan_terms
+         << ", removed terms: "s << compaction.removed_terms << ", orphan terms after compaction: "s
+         << after.orphan_terms << endl;
+}
+
+void Test22() {
+    const string path = (filesystem::temp_directory_path() / "search_server_test22.wal"s).string();
+    filesystem::remove(path);
+    {
+        SearchServer search_server("and with"s);
+        WriteAheadLog wal(path);
+        // сначала меняется индекс: он проверяет аргументы, и некорректное изменение не попадёт в журнал
+        search_server.AddDocument(1, "funny pet and nasty rat"s, DocumentStatus::ACTUAL, {7, 2, 7});
+        wal.LogAddDocument(1, "funny pet and nasty rat"s, DocumentStatus::ACTUAL, {7, 2, 7});
+        search_server.AddDocument(2, "funny pet with curly hair"s, DocumentStatus::ACTUAL, {1, 2});
+        wal.LogAddDocument(2, "funny pet with curly hair"s, DocumentStatus::ACTUAL, {1, 2});
+        search_server.RemoveDocument(1);
+        // клиенту можно отвечать, когда изменение на диске
+        wal.WaitDurable(wal.LogRemoveDocument(1));
+    }
+
+    // после перезапуска индекс восстанавливается из журнала
+    SearchServer search_server("and with"s);
+    const WalReplayStats replay = ReplayWriteAheadLog(search_server, path);
+    cout << "replayed records: "s << replay.records << ", documents: "s << search_server.GetDocumentCount() << endl;
+    for (const Document &document: search_server.FindTopDocuments("curly nasty pet"s)) {
+        cout << document << endl;
+    }
+
+    // контрольная точка оставляет последнее изменение каждого документа, в том числе удаление:
+    // поверх корпуса, где документ 1 ещё есть, он не должен вернуться
+    WriteAheadLog(path).Checkpoint();
+    SearchServer restored("and with"s);
+    restored.AddDocument(1, "funny pet and nasty rat"s, DocumentStatus::ACTUAL, {7, 2, 7});
+    const WalReplayStats checkpoint_replay = ReplayWriteAheadLog(restored, path);
+    cout << "records after checkpoint: "s << checkpoint_replay.records << ", documents over the corpus: "s
+         << restored.GetDocumentCount() << endl;
+    filesystem::remove(path);
+}
+
+void Test23() {
+    SearchServer search_server("and with"s);
+    for (int id = 0; id < 10; ++id) {
+        search_server.AddDocument(id, id % 2 ? "funny pet and nasty rat"s : "curly dog"s, DocumentStatus::ACTUAL, {id});
+    }
+
+    // выгрузка всех совпадений без отбора лучших: результаты приходят блоками по возрастанию id
+    vector<Document> exported;
+    const size_t matched = search_server.ForEachMatchedDocument("funny rat"s, [&exported](const Document &document) {
+        exported.push_back(document);
+    });
+
+    // страницы не строятся заранее, любая из них вычисляется по номеру
+    const auto pages = Paginate(exported, 2);
+    cout << matched << " documents on "s << pages.size() << " pages, last page: "s << pages[pages.size() - 1] << endl;
+}
+
+void Test24() {
+    SearchServer search_server("and with"s);
+    search_server.AddDocument(1, {{"title"sv, "cat"sv}, {"body"sv, "white cat"sv}}, DocumentStatus::ACTUAL, {1});
+    search_server.AddDocument(2, {{"title"sv, "cat and collar"sv}, {"body"sv, "white cat"sv}},
+                              DocumentStatus::ACTUAL, {9});
+    search_server.AddDocument(3, {{"title"sv, "dog"sv}, {"body"sv, "fluffy dog"sv}}, DocumentStatus::ACTUAL, {5});
+
+    // при сильном усилении релевантность уходит в десятки тысяч, а порядок по-прежнему задаёт она, а не рейтинг
+    for (const Document &document : search_server.FindTopDocuments("cat title^100000"s)) {
+        PrintDocument(document);
+    }
+}
+
+void Test25() {
+    SearchServer search_server("and with"s);
+    search_server.AddDocument(1, {{"title"sv, "curly kitten"sv}, {"body"sv, "white cat"sv}}, DocumentStatus::ACTUAL, {5});
+    search_server.AddDocument(2, "tiger in zoo"s, DocumentStatus::ACTUAL, {3});
+
+    // "title" начинается с ti, но ti* ищет слова, а не имена полей: заголовок "curly kitten" не подходит
+    for (const string &query : {"ti*"s, "title:cu*"s}) {
+        cout << "Query ["s << query << "]:"s;
+        for (const Document &document : search_server.FindTopDocuments(query)) {
+            cout << " "s << document.id;
+        }
+        cout << endl;
+    }
+    // слова полей возвращаются в том же виде, в каком их пишут в запросе
+    const auto [words, status] = search_server.MatchDocument("title:curly cat"s, 1);
+    for (const string_view word : words) {
+        cout << word << " "s;
+    }
+    for (const auto &[word, freq] : search_server.GetWordFrequencies(1)) {
+        cout << word << "="s << freq << " "s;
+    }
+    cout << endl;
+}
+
+void Test26() {
+    SearchServer search_server("and with"s);
+    search_server.AddDocument(1, "curly cat"s, DocumentStatus::ACTUAL, {1});
+    search_server.AddDocument(2, "fluffy dog"s, DocumentStatus::ACTUAL, {2});
+
+    // пакет выполняется параллельно, а статистика собирается в очереди без общей блокировки
+    RequestQueue request_queue(search_server);
+    vector<string> queries;
+    for (int i = 0; i < 30; ++i) {
+        queries.push_back(i % 3 ? "cat"s : "parrot"s);
+    }
+    const auto results = ProcessQueries(request_queue, queries);
+    const auto day = request_queue.GetStats(chrono::hours(24), 2);
+    cout << results.size() << " queries, "s << day.requests << " recorded, "s
+         << request_queue.GetNoResultRequests() << " without results, top:"s;
+    for (const auto &[query, count] : day.top_queries) {
+        cout << " "s << query << "="s << count;
+    }
+    cout << endl;
+
+    // частые запросы считаются в том же окне, что и остальная статистика: старые интервалы в него не попадают
+    QueryStats stats(chrono::seconds(1), 10);
+    for (int i = 0; i < 5; ++i) {
+        stats.Record("cat"s, false, chrono::microseconds(10));
+    }
+    this_thread::sleep_for(chrono::milliseconds(1100));
+    stats.Record("dog"s, false, chrono::microseconds(10));
+    for (const chrono::seconds window : {chrono::seconds(1), chrono::seconds(10)}) {
+        const auto snapshot = stats.GetSnapshot(window, 2);
+        cout << "Window "s << snapshot.window.count() << "s, "s << snapshot.requests << " requests:"s;
+        for (const auto &[query, count] : snapshot.top_queries) {
+            cout << " "s << query << "="s << count;
+        }
+        cout << endl;
+    }
+}
+
+void Test27() {
+    // релевантности сгущены вокруг границ ячеек RELEVANCE_EPSILON, рейтинги перемешаны
+    mt19937 generator(27);
+    vector<Document> documents;
+    for (int id = 0; id < 200; ++id) {
+        const double relevance = 0.5 + static_cast<int>(generator() % 20) * 3e-7;
+        documents.emplace_back(id, relevance, static_cast<int>(generator() % 5));
+    }
+    RankTopDocuments(documents, documents.size());
+
+    // пары, которые старый компаратор поставил бы наоборот, отличаются по релевантности меньше чем на EPSILON
+    size_t inversions = 0;
+    double max_gap = 0.0;
+    for (size_t i = 0; i < documents.size(); ++i) {
+        for (size_t j = i + 1; j < documents.size(); ++j) {
+            const double gap = abs(documents[i].relevance - documents[j].relevance);
+            const bool old_order_reversed = gap < RELEVANCE_EPSILON
+                                            ? documents[j].rating > documents[i].rating
+                                            : documents[j].relevance > documents[i].relevance;
+            if (old_order_reversed) {
+                ++inversions;
+                max_gap = max(max_gap, gap);
+            }
+        }
+    }
+    cout << "Inversions against the epsilon comparator: "s << inversions << ", all within epsilon: "s
+         << (max_gap < RELEVANCE_EPSILON ? "yes"s : "no"s) << endl;
+}
+
+void Test28() {
+    SearchServer search_server("and with"s);
+    search_server.SetTermFreqEncoding(TermFreqEncoding::QUANTIZED_16);
+    const vector<string> words = {"cat"s, "dog"s, "white"s, "fluffy"s, "tail"s, "collar"s, "eyes"s};
+    mt19937 generator(28);
+    for (int id = 0; id < 500; ++id) {
+        string text;
+        for (size_t i = 0, length = 3 + generator() % 15; i < length; ++i) {
+            text += words[generator() % words.size()] + " "s;
+        }
+        search_server.AddDocument(id, text, DocumentStatus::ACTUAL, {id % 7});
+    }
+
+    // последовательный поиск читает частоты из списков документов, параллельный — из прямого индекса;
+    // при квантовании оба видят одни и те же округлённые значения
+    size_t mismatches = 0;
+    for (const string query : {"cat"s, "white cat -dog"s, "fluffy tail collar eyes"s}) {
+        const auto sequenced = search_server.FindTopDocuments(execution::seq, query);
+        const auto parallel = search_server.FindTopDocuments(execution::par, query);
+        mismatches += !equal(sequenced.begin(), sequenced.end(), parallel.begin(), parallel.end(),
+                             [](const Document &lhs, const Document &rhs) {
+                                 return lhs.id == rhs.id && lhs.relevance == rhs.relevance && lhs.rating == rhs.rating;
+                             });
+    }
+    cout << "Quantized sequential and parallel results differ for "s << mismatches << " queries, index "s
+         << (search_server.Verify().IsConsistent() ? "consistent"s : "inconsistent"s) << endl;
+}
+
 int main() {
 
     Test0();
@@ -240,8 +741,28 @@ int main() {
     Test4();
     Test5();
     Test6();
-
-    parallel_test();
+    Test7();
+    Test8();
+    Test9();
+    Test10();
+    Test11();
+    Test12();
+    Test13();
+    Test14();
+    Test15();
+    Test16();
+    Test17();
+    Test18();
+    Test19();
+    Test20();
+    Test21();
+    Test22();
+    Test23();
+    Test24();
+    Test25();
+    Test26();
+    Test27();
+    Test28();
 
     return 0;
 }
@@ -0,0 +1,73 @@
+#include "memory_accounting.h"
+
+#include <algorithm>
+#include <string>
+#include <utility>
+#include <vector>
+
+using namespace std;
+
+void* CountingResource::do_allocate(size_t bytes, size_t alignment) {
+    void* const p = upstream_->allocate(bytes, alignment);
+#ifdef SEARCH_SERVER_MEMORY_ACCOUNTING
+    const size_t current = bytes_.fetch_add(bytes, memory_order_relaxed) + bytes;
+    size_t peak = peak_bytes_.load(memory_order_relaxed);
+    while (peak < current && !peak_bytes_.compare_exchange_weak(peak, current, memory_order_relaxed)) {
+    }
+    allocations_.fetch_add(1, memory_order_relaxed);
+#endif
+    return p;
+}
+
+void CountingResource::do_deallocate(void* p, size_t bytes, size_t alignment) {
+    upstream_->deallocate(p, bytes, alignment);
+#ifdef SEARCH_SERVER_MEMORY_ACCOUNTING
+    bytes_.fetch_sub(bytes, memory_order_relaxed);
+    allocations_.fetch_sub(1, memory_order_relaxed);
+#endif
+}
+
+void ExportMemoryStats(std::ostream& out, const IndexMemoryStats& stats, ExportFormat format) {
+    const vector<pair<string, const StructureMemoryStats*>> structures = {
+            {"words"s, &stats.words},
+            {"document_to_word_freqs"s, &stats.document_to_word_freqs},
+            {"word_to_document_freqs"s, &stats.word_to_document_freqs},
+            {"documents"s, &stats.documents},
+            {"word_positions"s, &stats.word_positions},
+    };
+
+    if (format == ExportFormat::PROMETHEUS) {
+        out << "# TYPE search_server_index_bytes gauge\n"s;
+        for (const auto& [name, structure]: structures) {
+            out << "search_server_index_bytes{structure=\""s << name << "\"} "s << structure->bytes << '\n';
+        }
+        out << "# TYPE search_server_index_allocations gauge\n"s;
+        for (const auto& [name, structure]: structures) {
+            out << "search_server_index_allocations{structure=\""s << name << "\"} "s << structure->allocations << '\n';
+        }
+        out << "# TYPE search_server_index_total_bytes gauge\n"s
+            << "search_server_index_total_bytes "s << stats.total_bytes << '\n'
+            << "# TYPE search_server_vocabulary_size gauge\n"s
+            << "search_server_vocabulary_size "s << stats.vocabulary_size << '\n'
+            << "# TYPE search_server_postings gauge\n"s
+            << "search_server_postings "s << stats.postings_count << '\n'
+            << "# TYPE search_server_documents gauge\n"s
+            << "search_server_documents "s << stats.document_count << '\n'
+            << "# TYPE search_server_average_document_length gauge\n"s
+            << "search_server_average_document_length "s << stats.average_document_length << '\n';
+        return;
+    }
+
+    out << "{\"exact\": "s << (stats.exact ? "true"s : "false"s) << ", \"structures\": {"s;
+    bool first = true;
+    for (const auto& [name, structure]: structures) {
+        out << (first ? ""s : ", "s) << '"' << name << "\": {\"bytes\": "s << structure->bytes
+            << ", \"allocations\": "s << structure->allocations << '}';
+        first = false;
+    }
+    out << "}, \"total_bytes\": "s << stats.total_bytes
+        << ", \"vocabulary_size\": "s << stats.vocabulary_size
+        << ", \"postings\": "s << stats.postings_count
+        << ", \"documents\": "s << stats.document_count
+        << ", \"average_document_length\": "s << stats.average_document_length << "}\n"s;
+}
@@ -0,0 +1,77 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <memory_resource>
+#include <ostream>
+
+#include "instrumentation.h"
+
+// Ресурс памяти, который считает выделенные через него байты и передаёт запросы вышестоящему ресурсу.
+// Подключается к pmr-контейнерам индекса; без SEARCH_SERVER_MEMORY_ACCOUNTING счётчики не ведутся
+class CountingResource : public std::pmr::memory_resource {
+public:
+    explicit CountingResource(std::pmr::memory_resource *upstream = std::pmr::get_default_resource())
+            : upstream_(upstream) {
+    }
+
+    CountingResource(const CountingResource &) = delete;
+
+    CountingResource &operator=(const CountingResource &) = delete;
+
+    [[nodiscard]] size_t GetBytes() const {
+        return bytes_.load(std::memory_order_relaxed);
+    }
+
+    [[nodiscard]] size_t GetPeakBytes() const {
+        return peak_bytes_.load(std::memory_order_relaxed);
+    }
+
+    [[nodiscard]] size_t GetAllocationCount() const {
+        return allocations_.load(std::memory_order_relaxed);
+    }
+
+    [[nodiscard]] static constexpr bool IsCounting() {
+#ifdef SEARCH_SERVER_MEMORY_ACCOUNTING
+        return true;
+#else
+        return false;
+#endif
+    }
+
+private:
+    std::pmr::memory_resource *upstream_;
+    std::atomic<size_t> bytes_{0};
+    std::atomic<size_t> peak_bytes_{0};
+    std::atomic<size_t> allocations_{0};
+
+    void *do_allocate(size_t bytes, size_t alignment) override;
+
+    void do_deallocate(void *p, size_t bytes, size_t alignment) override;
+
+    [[nodiscard]] bool do_is_equal(const std::pmr::memory_resource &other) const noexcept override {
+        return this == &other;
+    }
+};
+
+struct StructureMemoryStats {
+    size_t bytes = 0;
+    size_t allocations = 0;
+};
+
+struct IndexMemoryStats {
+    StructureMemoryStats words;
+    StructureMemoryStats document_to_word_freqs;
+    StructureMemoryStats word_to_document_freqs;
+    StructureMemoryStats documents;
+    StructureMemoryStats word_positions;
+    size_t total_bytes = 0;
+    size_t vocabulary_size = 0;
+    size_t postings_count = 0;
+    size_t document_count = 0;
+    double average_document_length = 0.0;
+    // true — байты посчитаны CountingResource, false — оценены по числу узлов
+    bool exact = false;
+};
+
+void ExportMemoryStats(std::ostream &out, const IndexMemoryStats &stats, ExportFormat format);
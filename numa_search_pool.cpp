@@ -0,0 +1,142 @@
+#include "numa_search_pool.h"
+
+#include <stdexcept>
+
+using namespace std;
+
+NumaSearchPool::NumaSearchPool(const NumaTopology &topology, const ReplicaFactory &factory, size_t workers_per_node) {
+    if (topology.nodes.empty()) {
+        throw invalid_argument("NUMA topology has no nodes"s);
+    }
+    for (const NumaNode &numa_node: topology.nodes) {
+        auto node = make_unique<Node>();
+        node->topology = numa_node;
+        node->worker_count = workers_per_node > 0 ? workers_per_node : max<size_t>(1, numa_node.cpus.size());
+        nodes_.push_back(move(node));
+    }
+
+    vector<promise<void>> built(nodes_.size());
+    // Если поток не удалось создать, уже запущенные останавливаются и присоединяются здесь же:
+    // деструктор workers_ с присоединяемыми потоками вызвал бы std::terminate
+    try {
+        for (size_t i = 0; i < nodes_.size(); ++i) {
+            for (size_t worker = 0; worker < nodes_[i]->worker_count; ++worker) {
+                workers_.emplace_back([this, &node = *nodes_[i], builds_replica = worker == 0, &factory,
+                                       &promise = built[i]] {
+                    Work(node, builds_replica, factory, promise);
+                });
+            }
+        }
+        // Копии строятся на всех узлах одновременно
+        for (auto &promise: built) {
+            promise.get_future().get();
+        }
+    } catch (...) {
+        {
+            lock_guard guard(m_);
+            stopping_ = true;
+        }
+        batch_ready_.notify_all();
+        for (auto &worker: workers_) {
+            worker.join();
+        }
+        throw;
+    }
+}
+
+NumaSearchPool::~NumaSearchPool() {
+    {
+        lock_guard guard(m_);
+        stopping_ = true;
+    }
+    batch_ready_.notify_all();
+    for (auto &worker: workers_) {
+        worker.join();
+    }
+}
+
+void NumaSearchPool::Work(Node &node, bool builds_replica, const ReplicaFactory &factory, std::promise<void> &built) {
+    if (!PinCurrentThread(node.topology.cpus)) {
+        node.pinned = false;
+    }
+    if (builds_replica) {
+        try {
+            node.replica = make_unique<SearchServer>(factory());
+            built.set_value();
+        } catch (...) {
+            built.set_exception(current_exception());
+        }
+    }
+
+    uint64_t seen_generation = 0;
+    while (true) {
+        Batch *batch = nullptr;
+        {
+            unique_lock lock(m_);
+            batch_ready_.wait(lock, [&] { return stopping_ || generation_ != seen_generation; });
+            if (stopping_) {
+                return;
+            }
+            seen_generation = generation_;
+            batch = batch_;
+        }
+        RunBatch(node, *batch);
+        {
+            lock_guard guard(m_);
+            if (--batch->active_workers == 0) {
+                batch_done_.notify_all();
+            }
+        }
+    }
+}
+
+void NumaSearchPool::RunBatch(Node &node, Batch &batch) {
+    const auto start = chrono::steady_clock::now();
+    size_t processed = 0;
+    for (size_t i = batch.next++; i < batch.queries->size(); i = batch.next++) {
+        try {
+            (*batch.results)[i] = node.replica->FindTopDocuments((*batch.queries)[i]);
+        } catch (...) {
+            lock_guard guard(m_);
+            if (!batch.error) {
+                batch.error = current_exception();
+            }
+        }
+        ++processed;
+    }
+    if (processed > 0) {
+        node.queries += processed;
+        node.busy_ns += chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - start).count();
+    }
+}
+
+std::vector<std::vector<Document>> NumaSearchPool::ProcessQueries(const std::vector<std::string> &queries) {
+    lock_guard batch_guard(batch_mutex_);
+    vector<vector<Document>> results(queries.size());
+    Batch batch;
+    batch.queries = &queries;
+    batch.results = &results;
+    {
+        unique_lock lock(m_);
+        batch.active_workers = workers_.size();
+        batch_ = &batch;
+        ++generation_;
+        batch_ready_.notify_all();
+        batch_done_.wait(lock, [&batch] { return batch.active_workers == 0; });
+        batch_ = nullptr;
+    }
+    if (batch.error) {
+        rethrow_exception(batch.error);
+    }
+    return results;
+}
+
+std::vector<NumaNodeStats> NumaSearchPool::GetNodeStats() const {
+    vector<NumaNodeStats> stats;
+    stats.reserve(nodes_.size());
+    for (const auto &node: nodes_) {
+        stats.push_back({node->topology.id, node->worker_count, node->pinned.load(), node->queries.load(),
+                         chrono::nanoseconds(node->busy_ns.load())});
+    }
+    return stats;
+}
@@ -0,0 +1,94 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <exception>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "document.h"
+#include "numa_topology.h"
+#include "search_server.h"
+
+struct NumaNodeStats {
+    int node = 0;
+    size_t worker_count = 0;
+    // Удалось ли привязать потоки узла к его процессорам
+    bool pinned = false;
+    size_t queries = 0;
+    // Суммарное время, которое потоки узла провели за запросами
+    std::chrono::nanoseconds busy_time{0};
+};
+
+// Пакетная обработка запросов с копией индекса на каждом NUMA-узле. Потоки узла привязаны к его процессорам
+// и читают только свою копию, поэтому запросы не ходят за памятью на другой сокет. Копию строит фабрика
+// в потоке, уже привязанном к узлу: при стандартной политике ядра (first touch) страницы индекса
+// выделяются на этом же узле. Запросы пакета раздаются через общий счётчик, так что быстрый узел
+// забирает больше запросов, а тексты запросов малы и копировать их между узлами дёшево
+class NumaSearchPool {
+public:
+    using ReplicaFactory = std::function<SearchServer()>;
+
+    // workers_per_node = 0 — по потоку на каждый процессор узла
+    NumaSearchPool(const NumaTopology &topology, const ReplicaFactory &factory, size_t workers_per_node = 0);
+
+    NumaSearchPool(const NumaSearchPool &) = delete;
+
+    NumaSearchPool &operator=(const NumaSearchPool &) = delete;
+
+    ~NumaSearchPool();
+
+    // Результаты в порядке запросов, как у ProcessQueries. Первое исключение запроса пробрасывается
+    // после завершения пакета. Пакеты из разных потоков выполняются по очереди
+    std::vector<std::vector<Document>> ProcessQueries(const std::vector<std::string> &queries);
+
+    [[nodiscard]] size_t GetNodeCount() const {
+        return nodes_.size();
+    }
+
+    [[nodiscard]] const SearchServer &GetReplica(size_t node) const {
+        return *nodes_.at(node)->replica;
+    }
+
+    [[nodiscard]] std::vector<NumaNodeStats> GetNodeStats() const;
+
+private:
+    struct Node {
+        NumaNode topology;
+        std::unique_ptr<SearchServer> replica;
+        size_t worker_count = 0;
+        std::atomic<bool> pinned{true};
+        std::atomic<size_t> queries{0};
+        std::atomic<int64_t> busy_ns{0};
+    };
+
+    struct Batch {
+        const std::vector<std::string> *queries = nullptr;
+        std::vector<std::vector<Document>> *results = nullptr;
+        std::atomic<size_t> next{0};
+        size_t active_workers = 0;
+        std::exception_ptr error;
+    };
+
+    std::vector<std::unique_ptr<Node>> nodes_;
+    std::vector<std::thread> workers_;
+
+    std::mutex batch_mutex_;
+    std::mutex m_;
+    std::condition_variable batch_ready_;
+    std::condition_variable batch_done_;
+    Batch *batch_ = nullptr;
+    uint64_t generation_ = 0;
+    bool stopping_ = false;
+
+    void Work(Node &node, bool builds_replica, const ReplicaFactory &factory, std::promise<void> &built);
+
+    void RunBatch(Node &node, Batch &batch);
+};
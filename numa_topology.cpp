@@ -0,0 +1,142 @@
+#include "numa_topology.h"
+
+#include <algorithm>
+#include <charconv>
+#include <filesystem>
+#include <fstream>
+#include <stdexcept>
+#include <thread>
+
+#ifdef __linux__
+#include <sched.h>
+#endif
+
+using namespace std;
+
+namespace {
+int ParseCpuNumber(string_view text) {
+    int value = 0;
+    const auto [end, error] = from_chars(text.data(), text.data() + text.size(), value);
+    if (text.empty() || error != errc() || end != text.data() + text.size() || value < 0) {
+        throw invalid_argument("Invalid CPU number "s + string{text});
+    }
+    return value;
+}
+}
+
+std::vector<int> ParseCpuList(std::string_view text) {
+    while (!text.empty() && (text.back() == '\n' || text.back() == ' ')) {
+        text.remove_suffix(1);
+    }
+    vector<int> cpus;
+    while (!text.empty()) {
+        const size_t comma = min(text.find(','), text.size());
+        const string_view range = text.substr(0, comma);
+        text.remove_prefix(min(comma + 1, text.size()));
+        const size_t dash = range.find('-');
+        const int first = ParseCpuNumber(range.substr(0, dash));
+        const int last = dash == string_view::npos ? first : ParseCpuNumber(range.substr(dash + 1));
+        if (last < first) {
+            throw invalid_argument("Invalid CPU range "s + string{range});
+        }
+        for (int cpu = first; cpu <= last; ++cpu) {
+            cpus.push_back(cpu);
+        }
+    }
+    sort(cpus.begin(), cpus.end());
+    cpus.erase(unique(cpus.begin(), cpus.end()), cpus.end());
+    return cpus;
+}
+
+std::vector<int> GetAvailableCpus() {
+    vector<int> cpus;
+#ifdef __linux__
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    if (sched_getaffinity(0, sizeof(set), &set) == 0) {
+        for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu) {
+            if (CPU_ISSET(cpu, &set)) {
+                cpus.push_back(cpu);
+            }
+        }
+    }
+#endif
+    if (cpus.empty()) {
+        const int count = static_cast<int>(max(1u, thread::hardware_concurrency()));
+        for (int cpu = 0; cpu < count; ++cpu) {
+            cpus.push_back(cpu);
+        }
+    }
+    return cpus;
+}
+
+NumaTopology ReadNumaTopology(const std::string &sysfs_root) {
+    const vector<int> available = GetAvailableCpus();
+    NumaTopology topology;
+    error_code error;
+    for (const auto &entry: filesystem::directory_iterator(sysfs_root, error)) {
+        const string name = entry.path().filename().string();
+        if (name.size() <= 4 || name.compare(0, 4, "node"s) != 0
+            || !all_of(name.begin() + 4, name.end(), [](char c) { return c >= '0' && c <= '9'; })) {
+            continue;
+        }
+        ifstream input(entry.path() / "cpulist");
+        string cpulist;
+        if (!getline(input, cpulist)) {
+            continue;
+        }
+        NumaNode node{stoi(name.substr(4)), {}};
+        for (const int cpu: ParseCpuList(cpulist)) {
+            if (binary_search(available.begin(), available.end(), cpu)) {
+                node.cpus.push_back(cpu);
+            }
+        }
+        // Узлы только с памятью или с недоступными процессорами потоки обслуживать не могут
+        if (!node.cpus.empty()) {
+            topology.nodes.push_back(move(node));
+        }
+    }
+    if (topology.nodes.empty()) {
+        topology.nodes.push_back({0, available});
+    }
+    sort(topology.nodes.begin(), topology.nodes.end(), [](const NumaNode &lhs, const NumaNode &rhs) {
+        return lhs.id < rhs.id;
+    });
+    return topology;
+}
+
+NumaTopology SimulateNumaTopology(size_t node_count) {
+    if (node_count == 0) {
+        throw invalid_argument("NUMA node count must be positive"s);
+    }
+    const vector<int> available = GetAvailableCpus();
+    NumaTopology topology;
+    topology.simulated = true;
+    const size_t per_node = max<size_t>(1, available.size() / node_count);
+    for (size_t i = 0; i < node_count; ++i) {
+        NumaNode node{static_cast<int>(i), {}};
+        const size_t first = i * per_node;
+        // Последний узел забирает остаток
+        const size_t last = i + 1 == node_count ? max(available.size(), first + 1) : first + per_node;
+        for (size_t cpu = first; cpu < last; ++cpu) {
+            node.cpus.push_back(available[cpu % available.size()]);
+        }
+        topology.nodes.push_back(move(node));
+    }
+    return topology;
+}
+
+bool PinCurrentThread(const std::vector<int> &cpus) {
+#ifdef __linux__
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    for (const int cpu: cpus) {
+        if (cpu >= 0 && cpu < CPU_SETSIZE) {
+            CPU_SET(cpu, &set);
+        }
+    }
+    return !cpus.empty() && sched_setaffinity(0, sizeof(set), &set) == 0;
+#else
+    return false;
+#endif
+}
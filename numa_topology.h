@@ -0,0 +1,34 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+#include <vector>
+
+struct NumaNode {
+    int id = 0;
+    std::vector<int> cpus;
+};
+
+struct NumaTopology {
+    std::vector<NumaNode> nodes;
+    // true — узлы не прочитаны из системы, а получены делением доступных процессоров (SimulateNumaTopology)
+    bool simulated = false;
+};
+
+// Список процессоров в формате ядра: "0-3,8,10-11". Бросает std::invalid_argument на некорректной записи
+std::vector<int> ParseCpuList(std::string_view text);
+
+// Процессоры, на которых процессу разрешено работать
+std::vector<int> GetAvailableCpus();
+
+// Узлы из sysfs_root/node*/cpulist. Учитываются только процессоры, доступные процессу; если каталога нет
+// (не Linux, контейнер без sysfs), возвращается один узел со всеми доступными процессорами
+NumaTopology ReadNumaTopology(const std::string &sysfs_root = "/sys/devices/system/node");
+
+// node_count узлов, доступные процессоры делятся между ними подряд. Если процессоров меньше, чем узлов,
+// узлы используют процессоры по кругу. Позволяет проверить размещение по узлам на машине с одним узлом
+NumaTopology SimulateNumaTopology(size_t node_count);
+
+// Привязывает текущий поток к процессорам; false, если система этого не поддерживает или отказала
+bool PinCurrentThread(const std::vector<int> &cpus);
@@ -3,7 +3,8 @@
 #include <ostream>
 #include <iterator>
 #include <algorithm>
-#include <vector>
+#include <cstddef>
+#include <stdexcept>
 
 template <typename Iterator>
 class IteratorRange {
@@ -39,34 +40,93 @@ std::ostream& operator<<(std::ostream& out, const IteratorRange<Iterator>& range
     return out;
 }
 
+// Страницы не хранятся, а вычисляются при обращении: построение и переход к любой странице занимают O(1)
+// для итераторов произвольного доступа, поэтому выдача в миллион документов не требует вектора страниц
 template <typename Iterator>
 class Paginator {
 public:
-    Paginator(const Iterator& begin, const Iterator& end, size_t page_size) {
-        for (size_t left = std::distance(begin, end); left > 0;) {
-            const size_t current_page_size = std::min(page_size, left);
-            const Iterator current_page_end = std::next(begin, current_page_size);
-            pages_.push_back({begin, current_page_end});
-
-            left -= current_page_size;
-            begin = current_page_end;
+    class PageIterator {
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = IteratorRange<Iterator>;
+        using difference_type = std::ptrdiff_t;
+        using pointer = void;
+        using reference = IteratorRange<Iterator>;
+
+        PageIterator() = default;
+
+        PageIterator(const Iterator& first, size_t page_size, size_t left)
+            : first_(first)
+            , page_size_(page_size)
+            , left_(left) {
+        }
+
+        IteratorRange<Iterator> operator*() const {
+            return {first_, std::next(first_, std::min(page_size_, left_))};
+        }
+
+        PageIterator& operator++() {
+            const size_t current_page_size = std::min(page_size_, left_);
+            first_ = std::next(first_, current_page_size);
+            left_ -= current_page_size;
+            return *this;
+        }
+
+        PageIterator operator++(int) {
+            PageIterator previous = *this;
+            ++*this;
+            return previous;
+        }
+
+        // Итераторы одного Paginator различаются числом оставшихся элементов
+        bool operator==(const PageIterator& other) const {
+            return left_ == other.left_;
+        }
+
+        bool operator!=(const PageIterator& other) const {
+            return !(*this == other);
+        }
+
+    private:
+        Iterator first_;
+        size_t page_size_ = 0;
+        size_t left_ = 0;
+    };
+
+    Paginator(const Iterator& begin, const Iterator& end, size_t page_size)
+        : begin_(begin)
+        , end_(end)
+        , page_size_(page_size)
+        , item_count_(std::distance(begin, end)) {
+        if (page_size == 0) {
+            throw std::invalid_argument("Page size must be positive");
         }
     }
 
-    auto begin() const {
-        return pages_.begin();
+    PageIterator begin() const {
+        return {begin_, page_size_, item_count_};
     }
 
-    auto end() const {
-        return pages_.end();
+    PageIterator end() const {
+        return {end_, page_size_, 0};
     }
 
     size_t size() const {
-        return pages_.size();
+        return (item_count_ + page_size_ - 1) / page_size_;
+    }
+
+    IteratorRange<Iterator> operator[](size_t page) const {
+        const size_t first = std::min(page * page_size_, item_count_);
+        const size_t last = std::min(first + page_size_, item_count_);
+        const Iterator page_begin = std::next(begin_, first);
+        return {page_begin, std::next(page_begin, last - first)};
     }
 
 private:
-    std::vector<IteratorRange<Iterator>> pages_;
+    Iterator begin_;
+    Iterator end_;
+    size_t page_size_;
+    size_t item_count_;
 };
 
 template <typename Container>
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory_resource>
+#include <utility>
+#include <vector>
+
+// Позиции слова в документе: возрастающая последовательность, хранится как дельты в varint-кодировке
+class PositionList {
+public:
+    using allocator_type = std::pmr::polymorphic_allocator<std::byte>;
+
+    PositionList() = default;
+
+    explicit PositionList(const allocator_type &allocator)
+            : bytes_(allocator) {
+    }
+
+    PositionList(const PositionList &other, const allocator_type &allocator)
+            : bytes_(other.bytes_, allocator)
+            , last_position_(other.last_position_)
+            , count_(other.count_) {
+    }
+
+    PositionList(PositionList &&other, const allocator_type &allocator)
+            : bytes_(std::move(other.bytes_), allocator)
+            , last_position_(other.last_position_)
+            , count_(other.count_) {
+    }
+
+    void Append(uint32_t position);
+
+    [[nodiscard]] std::vector<uint32_t> Decode() const;
+
+    [[nodiscard]] size_t size() const {
+        return count_;
+    }
+
+private:
+    std::pmr::vector<uint8_t> bytes_;
+    uint32_t last_position_ = 0;
+    uint32_t count_ = 0;
+};
@@ -0,0 +1,262 @@
+#include "posting_list.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iterator>
+#include <stdexcept>
+#include <string>
+
+using namespace std;
+
+namespace {
+uint16_t QuantizeTermFreq(double term_freq) {
+    // Очень длинный документ не должен терять слово из-за округления до нуля
+    const long quantized = lround(term_freq / TERM_FREQ_QUANTUM);
+    return static_cast<uint16_t>(clamp(quantized, 1L, 65535L));
+}
+
+template<typename Values, typename Value>
+void InsertAt(Values &values, ptrdiff_t index, Value value) {
+    values.insert(next(values.begin(), index), value);
+}
+}
+
+double RoundTermFreq(double term_freq, TermFreqEncoding encoding) {
+    if (encoding == TermFreqEncoding::QUANTIZED_16) {
+        return QuantizeTermFreq(term_freq) * TERM_FREQ_QUANTUM;
+    }
+    return term_freq;
+}
+
+void PostingList::SetEncoding(TermFreqEncoding encoding) {
+    if (!empty()) {
+        throw logic_error("Term frequency encoding can be changed only for an empty posting list"s);
+    }
+    encoding_ = encoding;
+}
+
+void PostingList::Add(int document_id, double term_freq) {
+    ResetCachedIdf();
+    const bool quantized = encoding_ == TermFreqEncoding::QUANTIZED_16;
+    // Документы обычно добавляются с возрастающими id, тогда вставка сводится к push_back
+    if (document_ids_.empty() || document_ids_.back() < document_id) {
+        document_ids_.push_back(document_id);
+        if (quantized) {
+            quantized_freqs_.push_back(QuantizeTermFreq(term_freq));
+        } else {
+            term_freqs_.push_back(term_freq);
+        }
+        const double stored_freq = TermFreq(document_ids_.size() - 1);
+        if ((document_ids_.size() - 1) % POSTING_BLOCK_SIZE == 0) {
+            block_max_term_freqs_.push_back(stored_freq);
+        } else {
+            block_max_term_freqs_.back() = max(block_max_term_freqs_.back(), stored_freq);
+        }
+        max_term_freq_ = max(max_term_freq_, stored_freq);
+        return;
+    }
+    const auto it = lower_bound(document_ids_.begin(), document_ids_.end(), document_id);
+    const auto index = distance(document_ids_.begin(), it);
+    if (it != document_ids_.end() && *it == document_id) {
+        if (quantized) {
+            quantized_freqs_[index] = QuantizeTermFreq(term_freq);
+        } else {
+            term_freqs_[index] = term_freq;
+        }
+        UpdateBlockMax(index);
+        return;
+    }
+    document_ids_.insert(it, document_id);
+    if (quantized) {
+        InsertAt(quantized_freqs_, index, QuantizeTermFreq(term_freq));
+    } else {
+        InsertAt(term_freqs_, index, term_freq);
+    }
+    UpdateBlockMax(index);
+}
+
+void PostingList::Erase(int document_id) {
+    const auto it = lower_bound(document_ids_.begin(), document_ids_.end(), document_id);
+    if (it == document_ids_.end() || *it != document_id) {
+        return;
+    }
+    ResetCachedIdf();
+    const auto index = distance(document_ids_.begin(), it);
+    document_ids_.erase(it);
+    if (encoding_ == TermFreqEncoding::QUANTIZED_16) {
+        quantized_freqs_.erase(next(quantized_freqs_.begin(), index));
+    } else {
+        term_freqs_.erase(next(term_freqs_.begin(), index));
+    }
+    UpdateBlockMax(index);
+}
+
+bool PostingList::Contains(int document_id) const {
+    return binary_search(document_ids_.begin(), document_ids_.end(), document_id);
+}
+
+void PostingList::ShrinkToFit() {
+    document_ids_.shrink_to_fit();
+    term_freqs_.shrink_to_fit();
+    quantized_freqs_.shrink_to_fit();
+    block_max_term_freqs_.shrink_to_fit();
+}
+
+size_t PostingList::Seek(int document_id, size_t from) const {
+    size_t step = 1;
+    size_t bound = from;
+    while (bound < document_ids_.size() && document_ids_[bound] < document_id) {
+        from = bound + 1;
+        bound += step;
+        step *= 2;
+    }
+    const auto last = next(document_ids_.begin(), min(bound, document_ids_.size()));
+    return distance(document_ids_.begin(), lower_bound(next(document_ids_.begin(), from), last, document_id));
+}
+
+void PostingList::UpdateBlockMax(size_t first) {
+    // Записи после first сдвинулись, поэтому пересчитываются все блоки до конца списка
+    const size_t block_count = (size() + POSTING_BLOCK_SIZE - 1) / POSTING_BLOCK_SIZE;
+    block_max_term_freqs_.resize(block_count);
+    for (size_t block = first / POSTING_BLOCK_SIZE; block < block_count; ++block) {
+        const size_t end = min(size(), (block + 1) * POSTING_BLOCK_SIZE);
+        double block_max = 0.0;
+        for (size_t i = block * POSTING_BLOCK_SIZE; i < end; ++i) {
+            block_max = max(block_max, TermFreq(i));
+        }
+        block_max_term_freqs_[block] = block_max;
+    }
+    max_term_freq_ = block_max_term_freqs_.empty()
+                     ? 0.0 : *max_element(block_max_term_freqs_.begin(), block_max_term_freqs_.end());
+}
+
+void PostingList::ComputeScores(size_t first, size_t count, double weight, double *out) const {
+    if (encoding_ == TermFreqEncoding::QUANTIZED_16) {
+        const uint16_t *__restrict quantized = quantized_freqs_.data() + first;
+        for (size_t i = 0; i < count; ++i) {
+            out[i] = quantized[i] * TERM_FREQ_QUANTUM * weight;
+        }
+    } else {
+        const double *__restrict term_freqs = term_freqs_.data() + first;
+        for (size_t i = 0; i < count; ++i) {
+            out[i] = term_freqs[i] * weight;
+        }
+    }
+}
+
+void PostingsUnion::AddList(const PostingList &postings, double weight) {
+    if (!postings.empty()) {
+        cursors_.push_back({&postings, weight, 0, 0});
+        heap_built_ = false;
+    }
+}
+
+void PostingsUnion::FillBlock(size_t cursor_index) {
+    Cursor &cursor = cursors_[cursor_index];
+    cursor.block_start = cursor.position;
+    const size_t count = min(SCORE_BLOCK_SIZE, cursor.postings->size() - cursor.position);
+    cursor.postings->ComputeScores(cursor.position, count, cursor.weight,
+                                   block_scores_.data() + cursor_index * SCORE_BLOCK_SIZE);
+}
+
+void PostingsUnion::BuildHeap() {
+    heap_.resize(cursors_.size());
+    block_scores_.resize(cursors_.size() * SCORE_BLOCK_SIZE);
+    for (size_t i = 0; i < cursors_.size(); ++i) {
+        heap_[i] = i;
+        FillBlock(i);
+    }
+    make_heap(heap_.begin(), heap_.end(), [this](size_t lhs, size_t rhs) {
+        return CurrentId(lhs) > CurrentId(rhs);
+    });
+    heap_built_ = true;
+}
+
+bool PostingsUnion::Next(int &document_id, double &score) {
+    if (!heap_built_) {
+        BuildHeap();
+    }
+    if (heap_.empty()) {
+        return false;
+    }
+    const auto greater_id = [this](size_t lhs, size_t rhs) {
+        return CurrentId(lhs) > CurrentId(rhs);
+    };
+
+    document_id = CurrentId(heap_.front());
+    score = 0.0;
+    while (!heap_.empty() && CurrentId(heap_.front()) == document_id) {
+        pop_heap(heap_.begin(), heap_.end(), greater_id);
+        const size_t cursor_index = heap_.back();
+        Cursor &cursor = cursors_[cursor_index];
+        score += block_scores_[cursor_index * SCORE_BLOCK_SIZE + cursor.position - cursor.block_start];
+        ++scanned_count_;
+        if (++cursor.position < cursor.postings->size()) {
+            if (cursor.position - cursor.block_start == SCORE_BLOCK_SIZE) {
+                FillBlock(cursor_index);
+            }
+            push_heap(heap_.begin(), heap_.end(), greater_id);
+        } else {
+            heap_.pop_back();
+        }
+    }
+    return true;
+}
+
+size_t PostingsMatcher::AddTerm(const PostingList &postings, double weight) {
+    terms_.push_back({&postings, weight, 0, 0.0, false, -1});
+    return terms_.size() - 1;
+}
+
+void PostingsMatcher::AddGroup(const std::vector<size_t> &terms) {
+    const auto document_freq = [this](const vector<size_t>& group) {
+        size_t result = 0;
+        for (const size_t term: group) {
+            result += terms_[term].postings->size();
+        }
+        return result;
+    };
+    const auto position = upper_bound(groups_.begin(), groups_.end(), document_freq(terms),
+                                      [&document_freq](size_t value, const vector<size_t>& group) {
+                                          return value < document_freq(group);
+                                      });
+    groups_.insert(position, terms);
+}
+
+void PostingsMatcher::SetMinimumMatch(size_t minimum_match) {
+    minimum_match_ = minimum_match;
+}
+
+bool PostingsMatcher::Evaluate(size_t term_index, int document_id) {
+    Term &term = terms_[term_index];
+    if (term.evaluated_for != document_id) {
+        term.position = term.postings->Seek(document_id, term.position);
+        term.present = term.position < term.postings->size() && term.postings->DocumentId(term.position) == document_id;
+        term.score = term.present ? term.postings->TermFreq(term.position) * term.weight : 0.0;
+        term.evaluated_for = document_id;
+    }
+    return term.present;
+}
+
+bool PostingsMatcher::Match(int document_id, double &score) {
+    size_t matched = 0;
+    for (size_t i = 0; i < groups_.size() && matched < minimum_match_; ++i) {
+        if (matched + (groups_.size() - i) < minimum_match_) {
+            return false;
+        }
+        bool group_matched = false;
+        for (const size_t term: groups_[i]) {
+            group_matched = Evaluate(term, document_id) || group_matched;
+        }
+        matched += group_matched ? 1 : 0;
+    }
+    if (matched < minimum_match_) {
+        return false;
+    }
+    score = 0.0;
+    for (size_t term = 0; term < terms_.size(); ++term) {
+        Evaluate(term, document_id);
+        score += terms_[term].score;
+    }
+    return true;
+}
@@ -0,0 +1,290 @@
+#pragma once
+
+#include <atomic>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <memory_resource>
+#include <utility>
+#include <vector>
+
+// Как хранить частоту слова в документе (count / число слов документа, значение в (0, 1]).
+// QUANTIZED_16 хранит round(tf * 65535) в uint16_t: список занимает 6 байт на документ вместо 12,
+// ошибка tf не больше TERM_FREQ_QUANTIZATION_ERROR, а релевантности — суммы idf * weight * этой ошибки
+// по словам запроса. Порядок документов сохраняется, если их релевантности отличаются больше чем
+// на удвоенную оценку ошибки
+enum class TermFreqEncoding {
+    EXACT,
+    QUANTIZED_16,
+};
+
+const double TERM_FREQ_QUANTUM = 1.0 / 65535;
+const double TERM_FREQ_QUANTIZATION_ERROR = TERM_FREQ_QUANTUM / 2;
+// Сколько записей списка покрывает одна наибольшая частота блока (block-max)
+const size_t POSTING_BLOCK_SIZE = 128;
+
+// Частота в том виде, в каком её хранит и возвращает TermFreq список с этим представлением. Прямой индекс
+// хранит те же значения, поэтому последовательный и параллельный поиск считают одинаковую релевантность
+double RoundTermFreq(double term_freq, TermFreqEncoding encoding);
+
+// Отсортированный по id список документов, содержащих слово, вместе с частотой слова в документе
+class PostingList {
+public:
+    using allocator_type = std::pmr::polymorphic_allocator<std::byte>;
+
+    PostingList() = default;
+
+    explicit PostingList(const allocator_type &allocator)
+            : document_ids_(allocator), term_freqs_(allocator), quantized_freqs_(allocator)
+            , block_max_term_freqs_(allocator) {
+    }
+
+    PostingList(const PostingList &other)
+            : encoding_(other.encoding_)
+            , document_ids_(other.document_ids_)
+            , term_freqs_(other.term_freqs_)
+            , quantized_freqs_(other.quantized_freqs_)
+            , block_max_term_freqs_(other.block_max_term_freqs_)
+            , max_term_freq_(other.max_term_freq_) {
+        CopyCachedIdf(other);
+    }
+
+    PostingList(PostingList &&other) noexcept
+            : encoding_(other.encoding_)
+            , document_ids_(std::move(other.document_ids_))
+            , term_freqs_(std::move(other.term_freqs_))
+            , quantized_freqs_(std::move(other.quantized_freqs_))
+            , block_max_term_freqs_(std::move(other.block_max_term_freqs_))
+            , max_term_freq_(other.max_term_freq_) {
+        CopyCachedIdf(other);
+    }
+
+    PostingList(const PostingList &other, const allocator_type &allocator)
+            : encoding_(other.encoding_)
+            , document_ids_(other.document_ids_, allocator)
+            , term_freqs_(other.term_freqs_, allocator)
+            , quantized_freqs_(other.quantized_freqs_, allocator)
+            , block_max_term_freqs_(other.block_max_term_freqs_, allocator)
+            , max_term_freq_(other.max_term_freq_) {
+        CopyCachedIdf(other);
+    }
+
+    PostingList(PostingList &&other, const allocator_type &allocator)
+            : encoding_(other.encoding_)
+            , document_ids_(std::move(other.document_ids_), allocator)
+            , term_freqs_(std::move(other.term_freqs_), allocator)
+            , quantized_freqs_(std::move(other.quantized_freqs_), allocator)
+            , block_max_term_freqs_(std::move(other.block_max_term_freqs_), allocator)
+            , max_term_freq_(other.max_term_freq_) {
+        CopyCachedIdf(other);
+    }
+
+    PostingList &operator=(const PostingList &other) {
+        encoding_ = other.encoding_;
+        document_ids_ = other.document_ids_;
+        term_freqs_ = other.term_freqs_;
+        quantized_freqs_ = other.quantized_freqs_;
+        block_max_term_freqs_ = other.block_max_term_freqs_;
+        max_term_freq_ = other.max_term_freq_;
+        CopyCachedIdf(other);
+        return *this;
+    }
+
+    PostingList &operator=(PostingList &&other) noexcept {
+        encoding_ = other.encoding_;
+        document_ids_ = std::move(other.document_ids_);
+        term_freqs_ = std::move(other.term_freqs_);
+        quantized_freqs_ = std::move(other.quantized_freqs_);
+        block_max_term_freqs_ = std::move(other.block_max_term_freqs_);
+        max_term_freq_ = other.max_term_freq_;
+        CopyCachedIdf(other);
+        return *this;
+    }
+
+    // Меняется только у пустого списка
+    void SetEncoding(TermFreqEncoding encoding);
+
+    [[nodiscard]] TermFreqEncoding GetEncoding() const {
+        return encoding_;
+    }
+
+    void Add(int document_id, double term_freq);
+
+    void Erase(int document_id);
+
+    [[nodiscard]] bool Contains(int document_id) const;
+
+    // Отдаёт запас ёмкости, накопившийся после удалений
+    void ShrinkToFit();
+
+    [[nodiscard]] size_t size() const {
+        return document_ids_.size();
+    }
+
+    [[nodiscard]] bool empty() const {
+        return document_ids_.empty();
+    }
+
+    [[nodiscard]] int DocumentId(size_t index) const {
+        return document_ids_[index];
+    }
+
+    [[nodiscard]] double TermFreq(size_t index) const {
+        if (encoding_ == TermFreqEncoding::QUANTIZED_16) {
+            return quantized_freqs_[index] * TERM_FREQ_QUANTUM;
+        }
+        return term_freqs_[index];
+    }
+
+    // out[i] = TermFreq(first + i) * weight для count записей подряд, с тем же округлением, что и произведение
+    // TermFreq на weight. Простой цикл по непрерывным массивам без ветвлений, компилятор векторизует его
+    // для обоих представлений
+    void ComputeScores(size_t first, size_t count, double weight, double *out) const;
+
+    [[nodiscard]] const std::pmr::vector<int> &DocumentIds() const {
+        return document_ids_;
+    }
+
+    // Индекс первой записи с id не меньше document_id среди записей начиная с from. Поиск галопом:
+    // при обходе возрастающих id стоит O(log расстояния), а не O(log size())
+    [[nodiscard]] size_t Seek(int document_id, size_t from) const;
+
+    // Наибольшая частота слова по всему списку и по блокам из POSTING_BLOCK_SIZE записей.
+    // Поддерживаются при каждом изменении списка; для QUANTIZED_16 — уже округлённые значения
+    [[nodiscard]] double GetMaxTermFreq() const {
+        return max_term_freq_;
+    }
+
+    [[nodiscard]] const std::pmr::vector<double> &GetBlockMaxTermFreqs() const {
+        return block_max_term_freqs_;
+    }
+
+    // log(document_count / size()). Значение кэшируется, пока не изменится список или число документов.
+    // Конкурентные запросы могут вызывать метод одновременно: при промахе каждый вычислит одно и то же
+    [[nodiscard]] double GetInverseDocumentFreq(size_t document_count) const {
+        if (idf_document_count_.load(std::memory_order_acquire) == document_count) {
+            return idf_.load(std::memory_order_relaxed);
+        }
+        const double idf = std::log(document_count * 1.0 / document_ids_.size());
+        idf_.store(idf, std::memory_order_relaxed);
+        idf_document_count_.store(document_count, std::memory_order_release);
+        return idf;
+    }
+
+private:
+    static constexpr size_t NO_CACHED_IDF = SIZE_MAX;
+
+    TermFreqEncoding encoding_ = TermFreqEncoding::EXACT;
+    std::pmr::vector<int> document_ids_;
+    std::pmr::vector<double> term_freqs_;
+    std::pmr::vector<uint16_t> quantized_freqs_;
+    std::pmr::vector<double> block_max_term_freqs_;
+    double max_term_freq_ = 0.0;
+    mutable std::atomic<double> idf_{0.0};
+    mutable std::atomic<size_t> idf_document_count_{NO_CACHED_IDF};
+
+    void CopyCachedIdf(const PostingList &other) {
+        idf_.store(other.idf_.load(std::memory_order_relaxed), std::memory_order_relaxed);
+        idf_document_count_.store(other.idf_document_count_.load(std::memory_order_acquire),
+                                  std::memory_order_release);
+    }
+
+    // Пересчитывает наибольшие частоты блоков, начиная с блока записи first
+    void UpdateBlockMax(size_t first);
+
+    void ResetCachedIdf() {
+        idf_document_count_.store(NO_CACHED_IDF, std::memory_order_relaxed);
+    }
+};
+
+// Объединение нескольких списков через кучу курсоров: документы выдаются по возрастанию id,
+// вклад каждого списка (term_freq * weight) суммируется за один проход.
+// Вклады считаются блоками по SCORE_BLOCK_SIZE записей через PostingList::ComputeScores
+class PostingsUnion {
+public:
+    static constexpr size_t SCORE_BLOCK_SIZE = 64;
+
+    void AddList(const PostingList &postings, double weight);
+
+    // Возвращает false, когда все списки исчерпаны
+    bool Next(int &document_id, double &score);
+
+    [[nodiscard]] bool Exhausted() const {
+        return heap_built_ ? heap_.empty() : cursors_.empty();
+    }
+
+    // Сколько записей списков уже выдано через Next
+    [[nodiscard]] size_t GetScannedCount() const {
+        return scanned_count_;
+    }
+
+private:
+    struct Cursor {
+        const PostingList *postings;
+        double weight;
+        size_t position;
+        size_t block_start;
+    };
+
+    std::vector<Cursor> cursors_;
+    std::vector<size_t> heap_;
+    // Вклады текущего блока каждого курсора, SCORE_BLOCK_SIZE значений на курсор
+    std::vector<double> block_scores_;
+    bool heap_built_ = false;
+    size_t scanned_count_ = 0;
+
+    [[nodiscard]] int CurrentId(size_t cursor) const {
+        return cursors_[cursor].postings->DocumentId(cursors_[cursor].position);
+    }
+
+    void FillBlock(size_t cursor);
+
+    void BuildHeap();
+};
+
+// Проверка кандидатов на совпадение хотя бы с minimum_match группами слов запроса и подсчёт их релевантности.
+// Группа совпала, если в документе есть любое её слово. Кандидаты подаются по возрастанию id, поэтому каждый
+// список проходится галопом один раз за запрос; группы проверяются от самой редкой, и кандидат отбрасывается,
+// как только оставшихся групп не хватает до minimum_match
+class PostingsMatcher {
+public:
+    // Возвращает номер слова для AddGroup
+    size_t AddTerm(const PostingList &postings, double weight);
+
+    void AddGroup(const std::vector<size_t> &terms);
+
+    void SetMinimumMatch(size_t minimum_match);
+
+    // Группы в порядке проверки: по возрастанию суммарной длины списков
+    [[nodiscard]] const std::vector<std::vector<size_t>> &GetGroups() const {
+        return groups_;
+    }
+
+    [[nodiscard]] const PostingList &GetPostings(size_t term) const {
+        return *terms_[term].postings;
+    }
+
+    [[nodiscard]] double GetWeight(size_t term) const {
+        return terms_[term].weight;
+    }
+
+    // score — сумма вкладов всех слов в порядке их добавления
+    bool Match(int document_id, double &score);
+
+private:
+    struct Term {
+        const PostingList *postings;
+        double weight;
+        size_t position;
+        double score;
+        bool present;
+        int evaluated_for;
+    };
+
+    std::vector<Term> terms_;
+    std::vector<std::vector<size_t>> groups_;
+    size_t minimum_match_ = 1;
+
+    // Есть ли слово в документе; вклад запоминается в Term::score
+    bool Evaluate(size_t term, int document_id);
+};
@@ -15,6 +15,28 @@ std::vector<std::vector<Document>> ProcessQueries(
     return result;
 }
 
+std::vector<std::vector<Document>> ProcessQueries(
+        RequestQueue &request_queue,
+        const std::vector<std::string> &queries) {
+    std::vector<std::vector<Document>> result(queries.size());
+    std::transform(std::execution::par, queries.cbegin(), queries.cend(), result.begin(),
+                   [&request_queue](const std::string &query) {
+                       return request_queue.AddFindRequest(query);
+                   });
+    return result;
+}
+
+std::vector<TopDocumentsResult> ProcessQueries(
+        const SearchServer &search_server,
+        const std::vector<std::string> &queries,
+        const QueryBudget &budget) {
+    std::vector<TopDocumentsResult> result(queries.size());
+    std::transform(std::execution::par, queries.cbegin(), queries.cend(), result.begin(),
+                   [&search_server, &budget](const std::string &query) {
+                       return search_server.FindTopDocumentsWithinBudget(budget, query);
+                   });
+    return result;
+}
 
 std::vector<Document> ProcessQueriesJoined(
         const SearchServer &search_server,
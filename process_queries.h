@@ -3,6 +3,7 @@
 #include <vector>
 #include "document.h"
 #include "search_server.h"
+#include "request_queue.h"
 
 std::vector<std::vector<Document>> ProcessQueries(
         const SearchServer& search_server,
@@ -11,3 +12,15 @@ std::vector<std::vector<Document>> ProcessQueries(
 std::vector<Document> ProcessQueriesJoined(
         const SearchServer& search_server,
         const std::vector<std::string>& queries);
+
+// Запросы выполняются параллельно, статистика собирается в request_queue
+std::vector<std::vector<Document>> ProcessQueries(
+        RequestQueue& request_queue,
+        const std::vector<std::string>& queries);
+
+// Каждый запрос ограничен budget, отсчёт времени идёт от начала его выполнения.
+// Запросы, упёршиеся в бюджет, возвращают частичный результат и не задерживают остальной пакет
+std::vector<TopDocumentsResult> ProcessQueries(
+        const SearchServer& search_server,
+        const std::vector<std::string>& queries,
+        const QueryBudget& budget);
@@ -0,0 +1,32 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <limits>
+#include <vector>
+
+#include "document.h"
+
+// Ограничение на работу одного запроса. По умолчанию ограничений нет
+struct QueryBudget {
+    using Clock = std::chrono::steady_clock;
+
+    // Отсчитывается от начала запроса
+    std::chrono::nanoseconds timeout = std::chrono::nanoseconds::max();
+    // Сколько записей списков документов можно просмотреть при подсчёте релевантности
+    size_t max_postings = std::numeric_limits<size_t>::max();
+
+    [[nodiscard]] Clock::time_point GetDeadline(Clock::time_point start) const {
+        if (timeout >= Clock::time_point::max() - start) {
+            return Clock::time_point::max();
+        }
+        return start + std::chrono::duration_cast<Clock::duration>(timeout);
+    }
+};
+
+struct TopDocumentsResult {
+    std::vector<Document> documents;
+    // Бюджет исчерпан до конца подсчёта: documents — лучшие среди просмотренных документов
+    bool partial = false;
+    size_t scanned_postings = 0;
+};
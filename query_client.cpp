@@ -0,0 +1,90 @@
+#include "query_client.h"
+
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "query_socket.h"
+
+using namespace std;
+
+QueryClient::QueryClient(const std::string &endpoint)
+        : fd_(ConnectToEndpoint(ParseQueryEndpoint(endpoint))) {
+}
+
+QueryClient::~QueryClient() {
+    close(fd_);
+}
+
+void QueryClient::Send(const QueryRequest &request) {
+    output_.clear();
+    AppendQueryRequest(output_, request);
+    for (size_t offset = 0; offset < output_.size();) {
+        const ssize_t sent = send(fd_, output_.data() + offset, output_.size() - offset, MSG_NOSIGNAL);
+        if (sent < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            throw runtime_error("send: "s + strerror(errno));
+        }
+        offset += static_cast<size_t>(sent);
+    }
+}
+
+QueryResponse QueryClient::Receive() {
+    while (true) {
+        const string_view input = string_view(input_).substr(input_offset_);
+        if (const size_t frame_size = GetQueryFrameSize(input); frame_size > 0) {
+            QueryResponse response = ParseQueryResponse(
+                    input.substr(QUERY_FRAME_HEADER_SIZE, frame_size - QUERY_FRAME_HEADER_SIZE));
+            input_offset_ += frame_size;
+            return response;
+        }
+        // Недочитанный хвост переносится в начало буфера
+        input_.erase(0, input_offset_);
+        input_offset_ = 0;
+        char buffer[64 * 1024];
+        const ssize_t received = recv(fd_, buffer, sizeof(buffer), 0);
+        if (received < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            throw runtime_error("recv: "s + strerror(errno));
+        }
+        if (received == 0) {
+            throw runtime_error("Connection closed by server"s);
+        }
+        input_.append(buffer, static_cast<size_t>(received));
+    }
+}
+
+QueryResponse QueryClient::Call(QueryRequest request) {
+    request.request_id = next_request_id_++;
+    Send(request);
+    QueryResponse response = Receive();
+    if (response.type == QueryMessageType::ERROR) {
+        throw runtime_error(response.error);
+    }
+    return response;
+}
+
+std::vector<Document> QueryClient::FindTopDocuments(const std::string &query, DocumentStatus status) {
+    QueryRequest request;
+    request.type = QueryMessageType::FIND_TOP_DOCUMENTS;
+    request.status = status;
+    request.query = query;
+    return Call(move(request)).documents;
+}
+
+std::tuple<std::vector<std::string>, DocumentStatus> QueryClient::MatchDocument(const std::string &query,
+                                                                                int document_id) {
+    QueryRequest request;
+    request.type = QueryMessageType::MATCH_DOCUMENT;
+    request.document_id = document_id;
+    request.query = query;
+    QueryResponse response = Call(move(request));
+    return {move(response.words), response.status};
+}
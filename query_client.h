@@ -0,0 +1,40 @@
+#pragma once
+
+#include <string>
+#include <tuple>
+#include <vector>
+
+#include "document.h"
+#include "query_protocol.h"
+
+// Блокирующий клиент сервиса запросов. Запросы можно конвейеризовать: отправить несколько через Send
+// и затем читать ответы через Receive, они приходят в порядке выполнения пакетов.
+// Ошибки ввода-вывода бросают std::runtime_error
+class QueryClient {
+public:
+    explicit QueryClient(const std::string &endpoint);
+
+    QueryClient(const QueryClient &) = delete;
+
+    QueryClient &operator=(const QueryClient &) = delete;
+
+    ~QueryClient();
+
+    void Send(const QueryRequest &request);
+
+    QueryResponse Receive();
+
+    // Синхронные обёртки; ответ ERROR превращается в std::runtime_error
+    std::vector<Document> FindTopDocuments(const std::string &query, DocumentStatus status = DocumentStatus::ACTUAL);
+
+    std::tuple<std::vector<std::string>, DocumentStatus> MatchDocument(const std::string &query, int document_id);
+
+private:
+    int fd_ = -1;
+    std::string input_;
+    size_t input_offset_ = 0;
+    std::string output_;
+    uint32_t next_request_id_ = 0;
+
+    QueryResponse Call(QueryRequest request);
+};
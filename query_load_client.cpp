@@ -0,0 +1,173 @@
+#include "generators.h"
+#include "query_client.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <random>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+// Генератор нагрузки для search_server_query_service:
+//   search_server_load_client [--endpoint ENDPOINT] [--queries FILE] [--requests N]
+//                             [--connections N] [--pipeline N] [--seed N]
+// Каждое соединение обслуживается своим потоком и держит до --pipeline запросов в полёте.
+// Без --queries запросы генерируются из того же словаря, что и синтетический корпус сервиса.
+// Печатает пропускную способность и перцентили задержки на клиенте и на сервере
+
+using namespace std;
+
+namespace {
+const int SYNTHETIC_VOCABULARY_SIZE = 10000;
+const int SYNTHETIC_WORDS_PER_QUERY = 5;
+const double SYNTHETIC_ZIPF_EXPONENT = 1.1;
+const double MINUS_WORD_PROBABILITY = 0.1;
+
+using Clock = chrono::steady_clock;
+
+struct Latencies {
+    vector<chrono::nanoseconds> client;
+    vector<chrono::nanoseconds> server;
+    size_t errors = 0;
+};
+
+// Отправляет запросы с номерами start, start + step, ... и ждёт ответы на все
+Latencies RunConnection(const string &endpoint, const vector<string> &queries, size_t request_count,
+                        size_t start, size_t step, size_t pipeline) {
+    QueryClient client(endpoint);
+    Latencies result;
+    unordered_map<uint32_t, Clock::time_point> in_flight;
+    size_t next = start;
+    while (next < request_count || !in_flight.empty()) {
+        while (next < request_count && in_flight.size() < pipeline) {
+            QueryRequest request;
+            request.request_id = static_cast<uint32_t>(next);
+            request.query = queries[next % queries.size()];
+            in_flight[request.request_id] = Clock::now();
+            client.Send(request);
+            next += step;
+        }
+        const QueryResponse response = client.Receive();
+        const auto it = in_flight.find(response.request_id);
+        if (it == in_flight.end()) {
+            throw runtime_error("Unexpected response id "s + to_string(response.request_id));
+        }
+        result.client.push_back(Clock::now() - it->second);
+        result.server.emplace_back(response.latency_ns);
+        if (response.type == QueryMessageType::ERROR) {
+            ++result.errors;
+        }
+        in_flight.erase(it);
+    }
+    return result;
+}
+
+chrono::nanoseconds GetPercentile(const vector<chrono::nanoseconds> &sorted, double percentile) {
+    if (sorted.empty()) {
+        return {};
+    }
+    const auto index = static_cast<size_t>(percentile / 100.0 * static_cast<double>(sorted.size() - 1));
+    return sorted[index];
+}
+
+void PrintLatencies(const string &name, vector<chrono::nanoseconds> &latencies) {
+    sort(latencies.begin(), latencies.end());
+    cout << name << " latency, us: p50 "s << GetPercentile(latencies, 50).count() / 1000.0
+         << ", p90 "s << GetPercentile(latencies, 90).count() / 1000.0
+         << ", p99 "s << GetPercentile(latencies, 99).count() / 1000.0
+         << ", p99.9 "s << GetPercentile(latencies, 99.9).count() / 1000.0
+         << ", max "s << (latencies.empty() ? 0.0 : latencies.back().count() / 1000.0) << endl;
+}
+
+[[noreturn]] void PrintUsageAndExit() {
+    cerr << "Usage: search_server_load_client [--endpoint ENDPOINT] [--queries FILE] [--requests N]"s
+         << " [--connections N] [--pipeline N] [--seed N]"s << endl;
+    exit(2);
+}
+}
+
+int main(int argc, char *argv[]) {
+    string endpoint = "unix:/tmp/search_server.sock"s;
+    string queries_path;
+    size_t request_count = 10000;
+    size_t connection_count = 4;
+    size_t pipeline = 16;
+    unsigned seed = 42;
+
+    for (int i = 1; i < argc; ++i) {
+        const string argument = argv[i];
+        if (i + 1 >= argc) {
+            PrintUsageAndExit();
+        }
+        const string value = argv[++i];
+        if (argument == "--endpoint"s) {
+            endpoint = value;
+        } else if (argument == "--queries"s) {
+            queries_path = value;
+        } else if (argument == "--requests"s) {
+            request_count = stoul(value);
+        } else if (argument == "--connections"s) {
+            connection_count = max<size_t>(1, stoul(value));
+        } else if (argument == "--pipeline"s) {
+            pipeline = max<size_t>(1, stoul(value));
+        } else if (argument == "--seed"s) {
+            seed = static_cast<unsigned>(stoul(value));
+        } else {
+            PrintUsageAndExit();
+        }
+    }
+
+    vector<string> queries;
+    if (!queries_path.empty()) {
+        ifstream input(queries_path);
+        for (string line; getline(input, line);) {
+            if (!line.empty()) {
+                queries.push_back(move(line));
+            }
+        }
+    } else {
+        mt19937 generator(seed);
+        const vector<string> vocabulary = GenerateVocabulary(generator, SYNTHETIC_VOCABULARY_SIZE, 10);
+        ZipfWordGenerator words(vocabulary, SYNTHETIC_ZIPF_EXPONENT);
+        queries = GenerateZipfTexts(generator, words, static_cast<int>(min<size_t>(request_count, 100000)),
+                                    SYNTHETIC_WORDS_PER_QUERY, MINUS_WORD_PROBABILITY);
+    }
+    if (queries.empty()) {
+        cerr << "No queries"s << endl;
+        return 1;
+    }
+
+    Latencies total;
+    mutex total_mutex;
+    vector<thread> threads;
+    const auto start_time = Clock::now();
+    for (size_t i = 0; i < connection_count; ++i) {
+        threads.emplace_back([&, i] {
+            try {
+                Latencies latencies = RunConnection(endpoint, queries, request_count, i, connection_count, pipeline);
+                lock_guard guard(total_mutex);
+                total.client.insert(total.client.end(), latencies.client.begin(), latencies.client.end());
+                total.server.insert(total.server.end(), latencies.server.begin(), latencies.server.end());
+                total.errors += latencies.errors;
+            } catch (const exception &e) {
+                lock_guard guard(total_mutex);
+                cerr << "Connection "s << i << ": "s << e.what() << endl;
+            }
+        });
+    }
+    for (auto &thread: threads) {
+        thread.join();
+    }
+    const chrono::duration<double> elapsed = Clock::now() - start_time;
+
+    cout << total.client.size() << " responses, "s << total.errors << " errors in "s << elapsed.count() << " s, "s
+         << static_cast<double>(total.client.size()) / elapsed.count() << " requests/s"s << endl;
+    PrintLatencies("Client"s, total.client);
+    PrintLatencies("Server"s, total.server);
+    return total.client.size() == request_count ? 0 : 1;
+}
@@ -0,0 +1,255 @@
+#include "query_protocol.h"
+
+#include <cstring>
+#include <stdexcept>
+
+using namespace std;
+
+namespace {
+// Сериализация в little-endian побайтово, независимо от порядка байтов платформы
+class Writer {
+public:
+    explicit Writer(string &out)
+            : out_(out), frame_start_(out.size()) {
+        PutUint32(0);
+    }
+
+    void PutUint8(uint8_t value) {
+        out_.push_back(static_cast<char>(value));
+    }
+
+    void PutUint32(uint32_t value) {
+        for (int shift = 0; shift < 32; shift += 8) {
+            out_.push_back(static_cast<char>((value >> shift) & 0xFF));
+        }
+    }
+
+    void PutUint64(uint64_t value) {
+        for (int shift = 0; shift < 64; shift += 8) {
+            out_.push_back(static_cast<char>((value >> shift) & 0xFF));
+        }
+    }
+
+    void PutInt32(int value) {
+        PutUint32(static_cast<uint32_t>(value));
+    }
+
+    void PutDouble(double value) {
+        uint64_t bits;
+        memcpy(&bits, &value, sizeof(bits));
+        PutUint64(bits);
+    }
+
+    void PutString(string_view value) {
+        PutUint32(static_cast<uint32_t>(value.size()));
+        out_.append(value);
+    }
+
+    // Записывает длину тела в заголовок кадра
+    void Finish() {
+        const size_t body_size = out_.size() - frame_start_ - QUERY_FRAME_HEADER_SIZE;
+        if (body_size > MAX_QUERY_FRAME_SIZE) {
+            out_.resize(frame_start_);
+            throw invalid_argument("Frame is too large"s);
+        }
+        for (size_t i = 0; i < QUERY_FRAME_HEADER_SIZE; ++i) {
+            out_[frame_start_ + i] = static_cast<char>((body_size >> (8 * i)) & 0xFF);
+        }
+    }
+
+private:
+    string &out_;
+    size_t frame_start_;
+};
+
+class Reader {
+public:
+    explicit Reader(string_view data)
+            : data_(data) {
+    }
+
+    uint8_t GetUint8() {
+        Require(1);
+        const auto value = static_cast<uint8_t>(data_[0]);
+        data_.remove_prefix(1);
+        return value;
+    }
+
+    uint32_t GetUint32() {
+        Require(4);
+        uint32_t value = 0;
+        for (int i = 0; i < 4; ++i) {
+            value |= static_cast<uint32_t>(static_cast<uint8_t>(data_[i])) << (8 * i);
+        }
+        data_.remove_prefix(4);
+        return value;
+    }
+
+    uint64_t GetUint64() {
+        Require(8);
+        uint64_t value = 0;
+        for (int i = 0; i < 8; ++i) {
+            value |= static_cast<uint64_t>(static_cast<uint8_t>(data_[i])) << (8 * i);
+        }
+        data_.remove_prefix(8);
+        return value;
+    }
+
+    int GetInt32() {
+        return static_cast<int>(GetUint32());
+    }
+
+    double GetDouble() {
+        const uint64_t bits = GetUint64();
+        double value;
+        memcpy(&value, &bits, sizeof(value));
+        return value;
+    }
+
+    string GetString() {
+        const uint32_t size = GetUint32();
+        Require(size);
+        string value(data_.substr(0, size));
+        data_.remove_prefix(size);
+        return value;
+    }
+
+    DocumentStatus GetStatus() {
+        const uint8_t status = GetUint8();
+        if (status > static_cast<uint8_t>(DocumentStatus::REMOVED)) {
+            throw invalid_argument("Invalid document status"s);
+        }
+        return static_cast<DocumentStatus>(status);
+    }
+
+    void ExpectEnd() const {
+        if (!data_.empty()) {
+            throw invalid_argument("Unexpected trailing bytes in frame"s);
+        }
+    }
+
+private:
+    string_view data_;
+
+    void Require(size_t size) const {
+        if (data_.size() < size) {
+            throw invalid_argument("Truncated frame"s);
+        }
+    }
+};
+}
+
+void AppendQueryRequest(std::string &out, const QueryRequest &request) {
+    Writer writer(out);
+    writer.PutUint8(static_cast<uint8_t>(request.type));
+    writer.PutUint32(request.request_id);
+    switch (request.type) {
+        case QueryMessageType::FIND_TOP_DOCUMENTS:
+            writer.PutUint8(static_cast<uint8_t>(request.status));
+            break;
+        case QueryMessageType::MATCH_DOCUMENT:
+            writer.PutInt32(request.document_id);
+            break;
+        default:
+            throw invalid_argument("Not a request type"s);
+    }
+    writer.PutString(request.query);
+    writer.Finish();
+}
+
+void AppendQueryResponse(std::string &out, const QueryResponse &response) {
+    Writer writer(out);
+    writer.PutUint8(static_cast<uint8_t>(response.type));
+    writer.PutUint32(response.request_id);
+    writer.PutUint64(response.latency_ns);
+    switch (response.type) {
+        case QueryMessageType::FIND_RESULT:
+            writer.PutUint32(static_cast<uint32_t>(response.documents.size()));
+            for (const Document &document: response.documents) {
+                writer.PutInt32(document.id);
+                writer.PutDouble(document.relevance);
+                writer.PutInt32(document.rating);
+            }
+            break;
+        case QueryMessageType::MATCH_RESULT:
+            writer.PutUint8(static_cast<uint8_t>(response.status));
+            writer.PutUint32(static_cast<uint32_t>(response.words.size()));
+            for (const string &word: response.words) {
+                writer.PutString(word);
+            }
+            break;
+        case QueryMessageType::ERROR:
+            writer.PutString(response.error);
+            break;
+        default:
+            throw invalid_argument("Not a response type"s);
+    }
+    writer.Finish();
+}
+
+size_t GetQueryFrameSize(std::string_view data) {
+    if (data.size() < QUERY_FRAME_HEADER_SIZE) {
+        return 0;
+    }
+    const uint32_t body_size = Reader(data).GetUint32();
+    if (body_size > MAX_QUERY_FRAME_SIZE) {
+        throw invalid_argument("Frame is too large"s);
+    }
+    const size_t frame_size = QUERY_FRAME_HEADER_SIZE + body_size;
+    return data.size() < frame_size ? 0 : frame_size;
+}
+
+QueryRequest ParseQueryRequest(std::string_view body) {
+    Reader reader(body);
+    QueryRequest request;
+    request.type = static_cast<QueryMessageType>(reader.GetUint8());
+    request.request_id = reader.GetUint32();
+    switch (request.type) {
+        case QueryMessageType::FIND_TOP_DOCUMENTS:
+            request.status = reader.GetStatus();
+            break;
+        case QueryMessageType::MATCH_DOCUMENT:
+            request.document_id = reader.GetInt32();
+            break;
+        default:
+            throw invalid_argument("Unknown request type"s);
+    }
+    request.query = reader.GetString();
+    reader.ExpectEnd();
+    return request;
+}
+
+QueryResponse ParseQueryResponse(std::string_view body) {
+    Reader reader(body);
+    QueryResponse response;
+    response.type = static_cast<QueryMessageType>(reader.GetUint8());
+    response.request_id = reader.GetUint32();
+    response.latency_ns = reader.GetUint64();
+    switch (response.type) {
+        case QueryMessageType::FIND_RESULT: {
+            const uint32_t count = reader.GetUint32();
+            for (uint32_t i = 0; i < count; ++i) {
+                const int id = reader.GetInt32();
+                const double relevance = reader.GetDouble();
+                const int rating = reader.GetInt32();
+                response.documents.emplace_back(id, relevance, rating);
+            }
+            break;
+        }
+        case QueryMessageType::MATCH_RESULT: {
+            response.status = reader.GetStatus();
+            const uint32_t count = reader.GetUint32();
+            for (uint32_t i = 0; i < count; ++i) {
+                response.words.push_back(reader.GetString());
+            }
+            break;
+        }
+        case QueryMessageType::ERROR:
+            response.error = reader.GetString();
+            break;
+        default:
+            throw invalid_argument("Unknown response type"s);
+    }
+    reader.ExpectEnd();
+    return response;
+}
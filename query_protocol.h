@@ -0,0 +1,62 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "document.h"
+
+// Двоичный протокол сервиса запросов. Каждое сообщение — кадр:
+// uint32 длина тела, затем тело: uint8 тип, uint32 id запроса и поля, зависящие от типа.
+// Числа передаются в little-endian, строки — как uint32 длина и байты.
+//
+// FIND_TOP_DOCUMENTS: uint8 статус документов, строка запроса
+// MATCH_DOCUMENT:     int32 id документа, строка запроса
+// FIND_RESULT:        uint64 задержка на сервере в нс, uint32 число документов,
+//                     для каждого int32 id, float64 релевантность, int32 рейтинг
+// MATCH_RESULT:       uint64 задержка в нс, uint8 статус документа, uint32 число слов, строки слов
+// ERROR:              uint64 задержка в нс, строка с текстом ошибки
+enum class QueryMessageType : uint8_t {
+    FIND_TOP_DOCUMENTS = 1,
+    MATCH_DOCUMENT = 2,
+    FIND_RESULT = 101,
+    MATCH_RESULT = 102,
+    ERROR = 200,
+};
+
+// Больше этого кадр считается повреждённым, соединение закрывается
+constexpr uint32_t MAX_QUERY_FRAME_SIZE = 16 * 1024 * 1024;
+constexpr size_t QUERY_FRAME_HEADER_SIZE = sizeof(uint32_t);
+
+struct QueryRequest {
+    QueryMessageType type = QueryMessageType::FIND_TOP_DOCUMENTS;
+    uint32_t request_id = 0;
+    DocumentStatus status = DocumentStatus::ACTUAL;
+    int document_id = 0;
+    std::string query;
+};
+
+struct QueryResponse {
+    QueryMessageType type = QueryMessageType::FIND_RESULT;
+    uint32_t request_id = 0;
+    uint64_t latency_ns = 0;
+    std::vector<Document> documents;
+    DocumentStatus status = DocumentStatus::ACTUAL;
+    std::vector<std::string> words;
+    std::string error;
+};
+
+// Дописывает кадр в конец out
+void AppendQueryRequest(std::string &out, const QueryRequest &request);
+
+void AppendQueryResponse(std::string &out, const QueryResponse &response);
+
+// Длина первого полного кадра в начале data вместе с заголовком или 0, если кадр ещё не дочитан.
+// Бросает std::invalid_argument, если заявленная длина больше MAX_QUERY_FRAME_SIZE
+size_t GetQueryFrameSize(std::string_view data);
+
+// body — тело кадра без заголовка длины. Бросает std::invalid_argument на некорректных данных
+QueryRequest ParseQueryRequest(std::string_view body);
+
+QueryResponse ParseQueryResponse(std::string_view body);
@@ -0,0 +1,323 @@
+#include "search_server.h"
+#include "document_loader.h"
+#include "ranking.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <execution>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+// Нагрузочный прогон по журналу запросов:
+//   search_server_replay --corpus FILE [--format tsv|jsonl] [--stop-words "a b c"] --queries LOG
+//                        [--policies seq,par,sharded,cached] [--requests N] [--concurrency N] [--rate QPS]
+//                        [--shards N] [--cache-size N]
+// Журнал — по запросу в строке; если в строке есть табуляции, запросом считается текст после последней
+// (так читаются журналы вида "время<TAB>запрос"). Запросы идут по кругу в порядке журнала, поэтому повторы
+// и распределение слов сохраняются.
+// Без --rate прогон замкнутый: --concurrency потоков отправляют следующий запрос сразу после ответа.
+// С --rate запросы назначаются на моменты start + i / rate, а задержка отсчитывается от назначенного
+// момента, так что очередь перед перегруженным сервером попадает в перцентили.
+// Для каждой политики печатает пропускную способность и перцентили задержки:
+//   seq     — FindTopDocuments(query)
+//   par     — FindTopDocuments(std::execution::par, query)
+//   sharded — корпус поделён по строкам на --shards серверов, запрос выполняется на всех параллельно,
+//             результаты сливаются. IDF у каждой части свой, поэтому ранжирование приблизительное:
+//             политика нужна для оценки мощности, а не качества
+//   cached  — seq за LRU-кэшем результатов на --cache-size запросов
+
+using namespace std;
+
+namespace {
+using Clock = chrono::steady_clock;
+using QueryFunction = function<vector<Document>(const string &)>;
+
+struct ReplayOptions {
+    size_t request_count = 0;
+    size_t concurrency = max(1u, thread::hardware_concurrency());
+    double rate = 0.0;
+};
+
+struct ReplayResult {
+    vector<chrono::nanoseconds> latencies;
+    size_t errors = 0;
+    chrono::duration<double> elapsed{0};
+};
+
+// Кэш результатов с вытеснением давно не запрошенных
+class QueryResultCache {
+public:
+    QueryResultCache(const SearchServer &search_server, size_t capacity)
+            : search_server_(search_server), capacity_(max<size_t>(1, capacity)) {
+    }
+
+    vector<Document> FindTopDocuments(const string &query) {
+        {
+            lock_guard guard(m_);
+            if (const auto it = index_.find(query); it != index_.end()) {
+                entries_.splice(entries_.begin(), entries_, it->second);
+                ++hits_;
+                return it->second->second;
+            }
+        }
+        // Поиск идёт без блокировки; одновременный промах по одному запросу посчитает его дважды
+        vector<Document> documents = search_server_.FindTopDocuments(query);
+        lock_guard guard(m_);
+        ++misses_;
+        if (index_.count(query) == 0) {
+            entries_.emplace_front(query, documents);
+            index_[query] = entries_.begin();
+            if (entries_.size() > capacity_) {
+                index_.erase(entries_.back().first);
+                entries_.pop_back();
+            }
+        }
+        return documents;
+    }
+
+    [[nodiscard]] double GetHitRate() const {
+        lock_guard guard(m_);
+        return hits_ + misses_ == 0 ? 0.0 : static_cast<double>(hits_) / static_cast<double>(hits_ + misses_);
+    }
+
+private:
+    using Entry = pair<string, vector<Document>>;
+
+    const SearchServer &search_server_;
+    const size_t capacity_;
+    mutable mutex m_;
+    list<Entry> entries_;
+    unordered_map<string, list<Entry>::iterator> index_;
+    size_t hits_ = 0;
+    size_t misses_ = 0;
+};
+
+vector<string> ReadQueryLog(const string &path) {
+    ifstream input(path);
+    if (!input) {
+        throw runtime_error("Cannot open query log "s + path);
+    }
+    vector<string> queries;
+    for (string line; getline(input, line);) {
+        if (!line.empty() && line.back() == '\r') {
+            line.pop_back();
+        }
+        if (const size_t tab = line.rfind('\t'); tab != string::npos) {
+            line.erase(0, tab + 1);
+        }
+        if (!line.empty()) {
+            queries.push_back(move(line));
+        }
+    }
+    return queries;
+}
+
+// Строки корпуса раскладываются по частям по кругу, каждая часть загружается отдельно
+vector<unique_ptr<SearchServer>> LoadShards(const string &corpus_path, CorpusFormat format,
+                                            const string &stop_words, size_t shard_count) {
+    const MappedFile file(corpus_path);
+    vector<string> shard_data(shard_count);
+    string_view data = file.GetData();
+    for (size_t line = 0; !data.empty(); ++line) {
+        const size_t end = min(data.find('\n'), data.size());
+        shard_data[line % shard_count].append(data.substr(0, end)).push_back('\n');
+        data.remove_prefix(min(end + 1, data.size()));
+    }
+    vector<unique_ptr<SearchServer>> shards;
+    for (const string &part: shard_data) {
+        auto shard = make_unique<SearchServer>(stop_words);
+        LoadDocuments(*shard, part, format);
+        shards.push_back(move(shard));
+    }
+    return shards;
+}
+
+vector<Document> FindTopDocumentsSharded(const vector<unique_ptr<SearchServer>> &shards, const string &query) {
+    vector<vector<Document>> results(shards.size());
+    transform(execution::par, shards.begin(), shards.end(), results.begin(), [&query](const auto &shard) {
+        return shard->FindTopDocuments(query);
+    });
+    vector<Document> merged;
+    for (const auto &documents: results) {
+        merged.insert(merged.end(), documents.begin(), documents.end());
+    }
+    RankTopDocuments(merged, MAX_RESULT_DOCUMENT_COUNT);
+    return merged;
+}
+
+ReplayResult Replay(const QueryFunction &find, const vector<string> &queries, const ReplayOptions &options) {
+    ReplayResult result;
+    result.latencies.resize(options.request_count);
+    atomic<size_t> next{0};
+    atomic<size_t> errors{0};
+    const auto start = Clock::now();
+    const auto scheduled_time = [&options, start](size_t request) {
+        return start + chrono::duration_cast<Clock::duration>(
+                chrono::duration<double>(static_cast<double>(request) / options.rate));
+    };
+
+    vector<thread> workers;
+    for (size_t i = 0; i < options.concurrency; ++i) {
+        workers.emplace_back([&] {
+            for (size_t request = next++; request < options.request_count; request = next++) {
+                Clock::time_point begin = Clock::now();
+                if (options.rate > 0.0) {
+                    const auto scheduled = scheduled_time(request);
+                    this_thread::sleep_until(scheduled);
+                    begin = scheduled;
+                }
+                try {
+                    static_cast<void>(find(queries[request % queries.size()]));
+                } catch (const exception &) {
+                    ++errors;
+                }
+                result.latencies[request] = Clock::now() - begin;
+            }
+        });
+    }
+    for (auto &worker: workers) {
+        worker.join();
+    }
+    result.elapsed = Clock::now() - start;
+    result.errors = errors;
+    return result;
+}
+
+chrono::nanoseconds GetPercentile(const vector<chrono::nanoseconds> &sorted, double percentile) {
+    if (sorted.empty()) {
+        return {};
+    }
+    const auto index = static_cast<size_t>(percentile / 100.0 * static_cast<double>(sorted.size() - 1));
+    return sorted[index];
+}
+
+void PrintResult(const string &policy, ReplayResult &result, const string &note) {
+    auto &latencies = result.latencies;
+    sort(latencies.begin(), latencies.end());
+    cout << policy << ": "s << latencies.size() << " requests, "s << result.errors << " errors in "s
+         << result.elapsed.count() << " s, "s << static_cast<double>(latencies.size()) / result.elapsed.count()
+         << " requests/s; latency, us: p50 "s << GetPercentile(latencies, 50).count() / 1000.0
+         << ", p90 "s << GetPercentile(latencies, 90).count() / 1000.0
+         << ", p99 "s << GetPercentile(latencies, 99).count() / 1000.0
+         << ", p99.9 "s << GetPercentile(latencies, 99.9).count() / 1000.0
+         << ", max "s << (latencies.empty() ? 0.0 : latencies.back().count() / 1000.0) << note << endl;
+}
+
+[[noreturn]] void PrintUsageAndExit() {
+    cerr << "Usage: search_server_replay --corpus FILE [--format tsv|jsonl] [--stop-words WORDS] --queries LOG"s
+         << " [--policies seq,par,sharded,cached] [--requests N] [--concurrency N] [--rate QPS]"s
+         << " [--shards N] [--cache-size N]"s << endl;
+    exit(2);
+}
+}
+
+int main(int argc, char *argv[]) {
+    string corpus_path;
+    CorpusFormat format = CorpusFormat::TSV;
+    string stop_words;
+    string queries_path;
+    string policies = "seq,par,sharded,cached"s;
+    ReplayOptions options;
+    size_t shard_count = 4;
+    size_t cache_size = 10000;
+
+    for (int i = 1; i < argc; ++i) {
+        const string argument = argv[i];
+        if (i + 1 >= argc) {
+            PrintUsageAndExit();
+        }
+        const string value = argv[++i];
+        if (argument == "--corpus"s) {
+            corpus_path = value;
+        } else if (argument == "--format"s) {
+            if (value != "tsv"s && value != "jsonl"s) {
+                PrintUsageAndExit();
+            }
+            format = value == "tsv"s ? CorpusFormat::TSV : CorpusFormat::JSONL;
+        } else if (argument == "--stop-words"s) {
+            stop_words = value;
+        } else if (argument == "--queries"s) {
+            queries_path = value;
+        } else if (argument == "--policies"s) {
+            policies = value;
+        } else if (argument == "--requests"s) {
+            options.request_count = stoul(value);
+        } else if (argument == "--concurrency"s) {
+            options.concurrency = max<size_t>(1, stoul(value));
+        } else if (argument == "--rate"s) {
+            options.rate = stod(value);
+        } else if (argument == "--shards"s) {
+            shard_count = max<size_t>(1, stoul(value));
+        } else if (argument == "--cache-size"s) {
+            cache_size = stoul(value);
+        } else {
+            PrintUsageAndExit();
+        }
+    }
+    if (corpus_path.empty() || queries_path.empty()) {
+        PrintUsageAndExit();
+    }
+
+    try {
+        const vector<string> queries = ReadQueryLog(queries_path);
+        if (queries.empty()) {
+            cerr << "No queries"s << endl;
+            return 1;
+        }
+        if (options.request_count == 0) {
+            options.request_count = queries.size();
+        }
+
+        SearchServer search_server(stop_words);
+        const LoadStats stats = LoadDocumentsFromFile(search_server, corpus_path, format);
+        cerr << stats.documents << " documents loaded from "s << corpus_path << ", "s << stats.errors << " errors"s
+             << (stats.errors ? " (first: "s + stats.first_error + ")"s : ""s) << "; "s << queries.size()
+             << " queries in the log"s << endl;
+
+        istringstream policy_list(policies);
+        for (string policy; getline(policy_list, policy, ',');) {
+            ReplayResult result;
+            string note;
+            if (policy == "seq"s) {
+                result = Replay([&search_server](const string &query) {
+                    return search_server.FindTopDocuments(query);
+                }, queries, options);
+            } else if (policy == "par"s) {
+                result = Replay([&search_server](const string &query) {
+                    return search_server.FindTopDocuments(execution::par, query);
+                }, queries, options);
+            } else if (policy == "sharded"s) {
+                const auto shards = LoadShards(corpus_path, format, stop_words, shard_count);
+                result = Replay([&shards](const string &query) {
+                    return FindTopDocumentsSharded(shards, query);
+                }, queries, options);
+                note = "; "s + to_string(shard_count) + " shards"s;
+            } else if (policy == "cached"s) {
+                QueryResultCache cache(search_server, cache_size);
+                result = Replay([&cache](const string &query) {
+                    return cache.FindTopDocuments(query);
+                }, queries, options);
+                note = "; hit rate "s + to_string(cache.GetHitRate());
+            } else {
+                cerr << "Unknown policy "s << policy << endl;
+                return 2;
+            }
+            PrintResult(policy, result, note);
+        }
+    } catch (const exception &e) {
+        cerr << e.what() << endl;
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,384 @@
+#include "query_service.h"
+
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <cstring>
+#include <execution>
+#include <stdexcept>
+
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "query_socket.h"
+
+using namespace std;
+
+namespace {
+// Идентификаторы в epoll_event::data: 0 — eventfd остановки, [1, FIRST_CONNECTION_ID) — слушающие сокеты
+const uint64_t WAKE_ID = 0;
+const uint64_t FIRST_CONNECTION_ID = uint64_t{1} << 32;
+const size_t MAX_EVENTS = 256;
+const size_t READ_BUFFER_SIZE = 64 * 1024;
+// Клиент, который не читает ответы, перестаёт читаться сам, когда неотправленных ответов больше этого
+const size_t MAX_OUTPUT_BUFFER_SIZE = 4 * 1024 * 1024;
+// Через сколько снова пробовать accept после нехватки дескрипторов, если ни одно соединение не закрылось
+const chrono::milliseconds ACCEPT_RETRY_DELAY{100};
+
+[[noreturn]] void ThrowSystemError(const string &what) {
+    throw runtime_error(what + ": "s + strerror(errno));
+}
+
+void AddToEpoll(int epoll_fd, int fd, uint32_t events, uint64_t id) {
+    epoll_event event{};
+    event.events = events;
+    event.data.u64 = id;
+    if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &event) != 0) {
+        ThrowSystemError("epoll_ctl"s);
+    }
+}
+}
+
+QueryService::QueryService(const SearchServer &search_server, QueryServiceOptions options)
+        : search_server_(search_server)
+        , options_(options)
+        , next_connection_id_(FIRST_CONNECTION_ID) {
+    if (options_.max_batch_size == 0) {
+        throw invalid_argument("Batch size must be positive"s);
+    }
+    epoll_fd_ = epoll_create1(EPOLL_CLOEXEC);
+    if (epoll_fd_ < 0) {
+        ThrowSystemError("epoll_create1"s);
+    }
+    wake_fd_ = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (wake_fd_ < 0) {
+        const int error = errno;
+        close(epoll_fd_);
+        errno = error;
+        ThrowSystemError("eventfd"s);
+    }
+    AddToEpoll(epoll_fd_, wake_fd_, EPOLLIN, WAKE_ID);
+}
+
+QueryService::~QueryService() {
+    for (auto &[id, connection]: connections_) {
+        close(connection.fd);
+    }
+    for (int listener: listeners_) {
+        close(listener);
+    }
+    for (const string &path: unix_paths_) {
+        unlink(path.c_str());
+    }
+    close(wake_fd_);
+    close(epoll_fd_);
+}
+
+uint16_t QueryService::Listen(const std::string &endpoint) {
+    const QueryEndpoint parsed = ParseQueryEndpoint(endpoint);
+    const int fd = OpenListeningSocket(parsed);
+    listeners_.push_back(fd);
+    AddToEpoll(epoll_fd_, fd, EPOLLIN, listeners_.size());
+    if (parsed.is_unix) {
+        unix_paths_.push_back(parsed.path);
+        return 0;
+    }
+    return GetBoundPort(fd);
+}
+
+void QueryService::Stop() {
+    const uint64_t value = 1;
+    // write допустим в обработчике сигнала
+    [[maybe_unused]] const auto written = write(wake_fd_, &value, sizeof(value));
+}
+
+void QueryService::Run() {
+    array<epoll_event, MAX_EVENTS> events{};
+    QueryStats::Clock::time_point batch_deadline;
+    bool stopped = false;
+    while (!stopped) {
+        int timeout = -1;
+        const auto wait_until = [&timeout](QueryStats::Clock::time_point deadline) {
+            const auto remaining = chrono::duration_cast<chrono::milliseconds>(deadline - QueryStats::Clock::now());
+            const int milliseconds = static_cast<int>(max<chrono::milliseconds::rep>(0, remaining.count()));
+            timeout = timeout < 0 ? milliseconds : min(timeout, milliseconds);
+        };
+        if (!pending_.empty()) {
+            wait_until(batch_deadline);
+        }
+        if (accept_paused_) {
+            wait_until(accept_retry_time_);
+        }
+        const int ready = epoll_wait(epoll_fd_, events.data(), static_cast<int>(events.size()), timeout);
+        if (ready < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            ThrowSystemError("epoll_wait"s);
+        }
+        const bool had_pending = !pending_.empty();
+        for (int i = 0; i < ready; ++i) {
+            const uint64_t id = events[i].data.u64;
+            if (id == WAKE_ID) {
+                stopped = true;
+            } else if (id < FIRST_CONNECTION_ID) {
+                AcceptConnections(listeners_[id - 1]);
+            } else if (connections_.count(id)) {
+                // Соединение могло закрыться при выполнении пакета раньше в этом же проходе
+                if (events[i].events & (EPOLLIN | EPOLLRDHUP | EPOLLHUP | EPOLLERR)) {
+                    ReadFromConnection(id);
+                }
+                if ((events[i].events & EPOLLOUT) && connections_.count(id)) {
+                    WriteToConnection(id);
+                }
+            }
+            if (pending_.size() >= options_.max_batch_size) {
+                ExecuteBatch();
+            }
+        }
+        if (!had_pending && !pending_.empty()) {
+            batch_deadline = QueryStats::Clock::now() + options_.batch_delay;
+        }
+        if (!pending_.empty() && QueryStats::Clock::now() >= batch_deadline) {
+            ExecuteBatch();
+        }
+        if (accept_paused_ && QueryStats::Clock::now() >= accept_retry_time_) {
+            ResumeAccepting();
+        }
+    }
+    // Уже принятые запросы получают ответы
+    if (!pending_.empty()) {
+        ExecuteBatch();
+    }
+}
+
+void QueryService::AcceptConnections(int listener_fd) {
+    while (true) {
+        const int fd = accept4(listener_fd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd < 0) {
+            if (errno == EINTR || errno == ECONNABORTED) {
+                continue;
+            }
+            if (errno == EMFILE || errno == ENFILE || errno == ENOBUFS || errno == ENOMEM) {
+                // Ожидающие соединения остаются в очереди слушающего сокета до освобождения дескриптора
+                PauseAccepting();
+            }
+            // Сбои отдельного соединения не останавливают сервис
+            return;
+        }
+        // Для Unix-сокетов опция не поддерживается, ошибка не важна
+        const int enable = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &enable, sizeof(enable));
+        const uint64_t id = next_connection_id_++;
+        AddToEpoll(epoll_fd_, fd, EPOLLIN | EPOLLRDHUP, id);
+        Connection &connection = connections_[id];
+        connection.fd = fd;
+        connection.events = EPOLLIN | EPOLLRDHUP;
+    }
+}
+
+void QueryService::PauseAccepting() {
+    if (!accept_paused_) {
+        for (const int listener: listeners_) {
+            epoll_ctl(epoll_fd_, EPOLL_CTL_DEL, listener, nullptr);
+        }
+        accept_paused_ = true;
+    }
+    accept_retry_time_ = QueryStats::Clock::now() + ACCEPT_RETRY_DELAY;
+}
+
+void QueryService::ResumeAccepting() {
+    if (!accept_paused_) {
+        return;
+    }
+    accept_paused_ = false;
+    for (size_t i = 0; i < listeners_.size(); ++i) {
+        AddToEpoll(epoll_fd_, listeners_[i], EPOLLIN, i + 1);
+    }
+}
+
+void QueryService::ReadFromConnection(uint64_t connection_id) {
+    Connection &connection = connections_.at(connection_id);
+    if (connection.read_closed) {
+        // На чтение соединение уже не подписано, значит, пришёл EPOLLHUP или EPOLLERR: отвечать некому
+        CloseConnection(connection_id);
+        return;
+    }
+    char buffer[READ_BUFFER_SIZE];
+    bool failed = false;
+    while (true) {
+        const ssize_t received = recv(connection.fd, buffer, sizeof(buffer), 0);
+        if (received > 0) {
+            connection.input.append(buffer, static_cast<size_t>(received));
+            continue;
+        }
+        if (received < 0 && errno == EINTR) {
+            continue;
+        }
+        if (received == 0) {
+            // Клиент закончил отправку, но ещё ждёт ответов на уже отправленные запросы
+            connection.read_closed = true;
+        } else {
+            failed = errno != EAGAIN && errno != EWOULDBLOCK;
+        }
+        break;
+    }
+    if (failed) {
+        CloseConnection(connection_id);
+        return;
+    }
+
+    const auto received_at = QueryStats::Clock::now();
+    string_view input = connection.input;
+    try {
+        for (size_t frame_size; (frame_size = GetQueryFrameSize(input)) > 0; input.remove_prefix(frame_size)) {
+            pending_.push_back({connection_id,
+                                ParseQueryRequest(input.substr(QUERY_FRAME_HEADER_SIZE,
+                                                               frame_size - QUERY_FRAME_HEADER_SIZE)),
+                                received_at});
+            ++connection.in_flight;
+        }
+    } catch (const invalid_argument &) {
+        // После повреждённого кадра границы следующих неизвестны; на принятые до него запросы ответим
+        connection.read_closed = true;
+        input = {};
+    }
+    connection.input.erase(0, connection.input.size() - input.size());
+    UpdateConnection(connection_id);
+}
+
+void QueryService::WriteToConnection(uint64_t connection_id) {
+    Connection &connection = connections_.at(connection_id);
+    while (connection.output_offset < connection.output.size()) {
+        const ssize_t sent = send(connection.fd, connection.output.data() + connection.output_offset,
+                                  connection.output.size() - connection.output_offset, MSG_NOSIGNAL);
+        if (sent < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                break;
+            }
+            CloseConnection(connection_id);
+            return;
+        }
+        connection.output_offset += static_cast<size_t>(sent);
+    }
+    if (connection.output_offset == connection.output.size()) {
+        connection.output.clear();
+        connection.output_offset = 0;
+    }
+    UpdateConnection(connection_id);
+}
+
+bool QueryService::UpdateConnection(uint64_t connection_id) {
+    Connection &connection = connections_.at(connection_id);
+    const size_t unsent = connection.output.size() - connection.output_offset;
+    if (connection.read_closed && connection.in_flight == 0 && unsent == 0) {
+        CloseConnection(connection_id);
+        return false;
+    }
+    uint32_t events = 0;
+    if (!connection.read_closed && unsent < MAX_OUTPUT_BUFFER_SIZE) {
+        events |= EPOLLIN | EPOLLRDHUP;
+    }
+    if (unsent > 0) {
+        events |= EPOLLOUT;
+    }
+    if (events != connection.events) {
+        epoll_event event{};
+        event.events = events;
+        event.data.u64 = connection_id;
+        epoll_ctl(epoll_fd_, EPOLL_CTL_MOD, connection.fd, &event);
+        connection.events = events;
+    }
+    return true;
+}
+
+void QueryService::CloseConnection(uint64_t connection_id) {
+    const auto it = connections_.find(connection_id);
+    if (it == connections_.end()) {
+        return;
+    }
+    epoll_ctl(epoll_fd_, EPOLL_CTL_DEL, it->second.fd, nullptr);
+    close(it->second.fd);
+    connections_.erase(it);
+    // Освободился дескриптор: можно снова принимать соединения
+    ResumeAccepting();
+}
+
+QueryResponse QueryService::Execute(const PendingRequest &pending) {
+    const QueryRequest &request = pending.request;
+    QueryResponse response;
+    response.request_id = request.request_id;
+    bool empty_result = false;
+    bool failed = false;
+    try {
+        if (request.type == QueryMessageType::FIND_TOP_DOCUMENTS) {
+            response.type = QueryMessageType::FIND_RESULT;
+            response.documents = search_server_.FindTopDocuments(request.query, request.status);
+            empty_result = response.documents.empty();
+        } else {
+            response.type = QueryMessageType::MATCH_RESULT;
+            const auto[words, status] = search_server_.MatchDocument(request.query, request.document_id);
+            response.words.assign(words.begin(), words.end());
+            response.status = status;
+            empty_result = words.empty();
+        }
+    } catch (const exception &e) {
+        response.type = QueryMessageType::ERROR;
+        response.error = e.what();
+        failed = true;
+    }
+    const auto latency = QueryStats::Clock::now() - pending.received;
+    response.latency_ns = static_cast<uint64_t>(chrono::duration_cast<chrono::nanoseconds>(latency).count());
+    if (failed) {
+        stats_.RecordFailure(request.query, latency);
+    } else {
+        stats_.Record(request.query, empty_result, latency);
+    }
+    return response;
+}
+
+void QueryService::ExecuteBatch() {
+    vector<QueryResponse> responses(pending_.size());
+    transform(execution::par, pending_.begin(), pending_.end(), responses.begin(),
+              [this](const PendingRequest &pending) {
+                  return Execute(pending);
+              });
+
+    vector<uint64_t> touched;
+    for (size_t i = 0; i < pending_.size(); ++i) {
+        const auto it = connections_.find(pending_[i].connection_id);
+        // Клиент мог отключиться, не дождавшись ответа
+        if (it == connections_.end()) {
+            continue;
+        }
+        if (it->second.output.empty()) {
+            touched.push_back(it->first);
+        }
+        --it->second.in_flight;
+        try {
+            AppendQueryResponse(it->second.output, responses[i]);
+        } catch (const invalid_argument &e) {
+            QueryResponse error;
+            error.type = QueryMessageType::ERROR;
+            error.request_id = responses[i].request_id;
+            error.latency_ns = responses[i].latency_ns;
+            error.error = e.what();
+            AppendQueryResponse(it->second.output, error);
+        }
+    }
+    pending_.clear();
+    for (uint64_t connection_id: touched) {
+        WriteToConnection(connection_id);
+    }
+}
+
+QueryStats::Snapshot QueryService::GetStats(std::chrono::seconds window, size_t top_count) const {
+    return stats_.GetSnapshot(window, top_count);
+}
@@ -0,0 +1,103 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "query_protocol.h"
+#include "query_stats.h"
+#include "search_server.h"
+
+struct QueryServiceOptions {
+    // Запросов в одном пакете, отдаваемом параллельному исполнителю
+    size_t max_batch_size = 256;
+    // Сколько ждать новых запросов, прежде чем выполнить неполный пакет. 0 — выполнять всё,
+    // что пришло за один проход цикла событий
+    std::chrono::milliseconds batch_delay{0};
+};
+
+// Сервис запросов поверх epoll: принимает кадры query_protocol.h через Unix- или TCP-сокеты,
+// собирает пришедшие запросы в пакеты и выполняет каждый пакет параллельно.
+// Задержка запроса считается от разбора кадра до готовности ответа, возвращается клиенту
+// и учитывается в статистике. Цикл событий работает в потоке, вызвавшем Run
+class QueryService {
+public:
+    explicit QueryService(const SearchServer &search_server, QueryServiceOptions options = {});
+
+    QueryService(const QueryService &) = delete;
+
+    QueryService &operator=(const QueryService &) = delete;
+
+    ~QueryService();
+
+    // Начинает прослушивание адреса вида "unix:PATH" или "HOST:PORT" (см. query_socket.h).
+    // Возвращает фактический TCP-порт или 0 для Unix-сокета
+    uint16_t Listen(const std::string &endpoint);
+
+    // Обслуживает соединения до вызова Stop
+    void Run();
+
+    // Можно вызывать из другого потока и из обработчика сигнала
+    void Stop();
+
+    [[nodiscard]] QueryStats::Snapshot GetStats(std::chrono::seconds window, size_t top_count = 10) const;
+
+private:
+    struct Connection {
+        int fd = -1;
+        std::string input;
+        std::string output;
+        size_t output_offset = 0;
+        // События, на которые соединение подписано в epoll
+        uint32_t events = 0;
+        // Клиент закончил отправку (shutdown(SHUT_WR)) или прислал повреждённый кадр: новые запросы не читаются,
+        // а соединение закрывается, когда все принятые запросы получат ответы и выходной буфер опустеет
+        bool read_closed = false;
+        // Запросы соединения, ждущие выполнения в pending_
+        size_t in_flight = 0;
+    };
+
+    struct PendingRequest {
+        uint64_t connection_id;
+        QueryRequest request;
+        QueryStats::Clock::time_point received;
+    };
+
+    const SearchServer &search_server_;
+    QueryServiceOptions options_;
+    QueryStats stats_;
+    int epoll_fd_ = -1;
+    int wake_fd_ = -1;
+    std::vector<int> listeners_;
+    std::vector<std::string> unix_paths_;
+    std::unordered_map<uint64_t, Connection> connections_;
+    uint64_t next_connection_id_;
+    std::vector<PendingRequest> pending_;
+    // При нехватке дескрипторов слушающие сокеты снимаются с epoll до закрытия какого-нибудь соединения
+    // или до accept_retry_time_, иначе готовый к accept сокет крутил бы цикл событий вхолостую
+    bool accept_paused_ = false;
+    QueryStats::Clock::time_point accept_retry_time_;
+
+    void AcceptConnections(int listener_fd);
+
+    void ReadFromConnection(uint64_t connection_id);
+
+    void WriteToConnection(uint64_t connection_id);
+
+    void CloseConnection(uint64_t connection_id);
+
+    // Подписывает соединение на чтение, пока оно открыто на чтение и не накопило слишком много неотправленных
+    // ответов, и на запись, пока выходной буфер не пуст. Закрывает соединение, которому больше нечего делать;
+    // возвращает false, если соединение закрыто
+    bool UpdateConnection(uint64_t connection_id);
+
+    void PauseAccepting();
+
+    void ResumeAccepting();
+
+    void ExecuteBatch();
+
+    QueryResponse Execute(const PendingRequest &pending);
+};
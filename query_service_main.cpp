@@ -0,0 +1,128 @@
+#include "search_server.h"
+#include "document_loader.h"
+#include "generators.h"
+#include "query_service.h"
+
+#include <csignal>
+#include <cstdlib>
+#include <iostream>
+#include <iterator>
+#include <random>
+#include <string>
+#include <vector>
+
+// Сервис запросов над корпусом из файла или синтетическим корпусом:
+//   search_server_query_service [--corpus FILE] [--format tsv|jsonl] [--synthetic DOCUMENTS]
+//                               [--stop-words "a b c"] [--listen ENDPOINT]...
+//                               [--batch-size N] [--batch-delay-ms N]
+// По умолчанию слушает unix:/tmp/search_server.sock. Синтетический корпус строится так же,
+// как запросы search_server_load_client с тем же --seed. SIGINT/SIGTERM завершают работу
+// с выводом статистики задержек
+
+using namespace std;
+
+namespace {
+const int SYNTHETIC_VOCABULARY_SIZE = 10000;
+const int SYNTHETIC_WORDS_PER_DOCUMENT = 50;
+const double SYNTHETIC_ZIPF_EXPONENT = 1.1;
+
+QueryService *running_service = nullptr;
+
+void HandleStopSignal(int) {
+    if (running_service) {
+        running_service->Stop();
+    }
+}
+
+[[noreturn]] void PrintUsageAndExit() {
+    cerr << "Usage: search_server_query_service [--corpus FILE] [--format tsv|jsonl] [--synthetic DOCUMENTS]"s
+         << " [--seed N] [--stop-words WORDS] [--listen ENDPOINT]... [--batch-size N] [--batch-delay-ms N]"s << endl;
+    exit(2);
+}
+}
+
+int main(int argc, char *argv[]) {
+    string corpus_path;
+    CorpusFormat format = CorpusFormat::TSV;
+    int synthetic_documents = 0;
+    unsigned seed = 42;
+    string stop_words;
+    vector<string> endpoints;
+    QueryServiceOptions options;
+
+    for (int i = 1; i < argc; ++i) {
+        const string argument = argv[i];
+        if (i + 1 >= argc) {
+            PrintUsageAndExit();
+        }
+        const string value = argv[++i];
+        if (argument == "--corpus"s) {
+            corpus_path = value;
+        } else if (argument == "--format"s) {
+            if (value != "tsv"s && value != "jsonl"s) {
+                PrintUsageAndExit();
+            }
+            format = value == "tsv"s ? CorpusFormat::TSV : CorpusFormat::JSONL;
+        } else if (argument == "--synthetic"s) {
+            synthetic_documents = stoi(value);
+        } else if (argument == "--seed"s) {
+            seed = static_cast<unsigned>(stoul(value));
+        } else if (argument == "--stop-words"s) {
+            stop_words = value;
+        } else if (argument == "--listen"s) {
+            endpoints.push_back(value);
+        } else if (argument == "--batch-size"s) {
+            options.max_batch_size = stoul(value);
+        } else if (argument == "--batch-delay-ms"s) {
+            options.batch_delay = chrono::milliseconds(stoi(value));
+        } else {
+            PrintUsageAndExit();
+        }
+    }
+    if (endpoints.empty()) {
+        endpoints.push_back("unix:/tmp/search_server.sock"s);
+    }
+
+    try {
+        SearchServer search_server(stop_words);
+        if (!corpus_path.empty()) {
+            const LoadStats stats = LoadDocumentsFromFile(search_server, corpus_path, format);
+            cerr << stats.documents << " documents loaded from "s << corpus_path << ", "s << stats.errors
+                 << " errors"s << (stats.errors ? " (first: "s + stats.first_error + ")"s : ""s) << endl;
+        }
+        if (synthetic_documents > 0) {
+            mt19937 generator(seed);
+            const vector<string> vocabulary = GenerateVocabulary(generator, SYNTHETIC_VOCABULARY_SIZE, 10);
+            ZipfWordGenerator words(vocabulary, SYNTHETIC_ZIPF_EXPONENT);
+            // id корпуса произвольны: синтетические документы идут после наибольшего из них
+            const int first_id = search_server.begin() != search_server.end() ? *prev(search_server.end()) + 1 : 0;
+            for (int i = 0; i < synthetic_documents; ++i) {
+                search_server.AddDocument(first_id + i, GenerateZipfText(generator, words, SYNTHETIC_WORDS_PER_DOCUMENT),
+                                          DocumentStatus::ACTUAL, {1, 2, 3});
+            }
+            cerr << synthetic_documents << " synthetic documents generated"s << endl;
+        }
+
+        QueryService service(search_server, options);
+        for (const string &endpoint: endpoints) {
+            const uint16_t port = service.Listen(endpoint);
+            cerr << "Listening on "s << endpoint << (port ? " (port "s + to_string(port) + ")"s : ""s) << endl;
+        }
+
+        running_service = &service;
+        signal(SIGINT, HandleStopSignal);
+        signal(SIGTERM, HandleStopSignal);
+        service.Run();
+        running_service = nullptr;
+
+        const QueryStats::Snapshot stats = service.GetStats(chrono::hours(24));
+        cerr << stats.requests << " requests, "s << stats.no_result_requests << " without results, "s
+             << stats.failed_requests << " failed; latency p50 "s
+             << stats.latency_p50.count() << " ns, p99 "s << stats.latency_p99.count() << " ns, max "s
+             << stats.latency_max.count() << " ns"s << endl;
+    } catch (const exception &e) {
+        cerr << e.what() << endl;
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,178 @@
+#include "query_socket.h"
+
+#include <cerrno>
+#include <charconv>
+#include <cstring>
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+using namespace std;
+
+namespace {
+[[noreturn]] void ThrowSystemError(const string &what) {
+    throw runtime_error(what + ": "s + strerror(errno));
+}
+
+sockaddr_un MakeUnixAddress(const string &path) {
+    sockaddr_un address{};
+    address.sun_family = AF_UNIX;
+    if (path.size() >= sizeof(address.sun_path)) {
+        throw invalid_argument("Unix socket path is too long: "s + path);
+    }
+    memcpy(address.sun_path, path.c_str(), path.size() + 1);
+    return address;
+}
+
+// Первый адрес из getaddrinfo, для которого удалось выполнить action
+template <typename Action>
+int ForEachTcpAddress(const QueryEndpoint &endpoint, int flags, Action action) {
+    addrinfo hints{};
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    hints.ai_flags = flags;
+    addrinfo *addresses = nullptr;
+    const string port = to_string(endpoint.port);
+    const char *host = endpoint.host.empty() ? nullptr : endpoint.host.c_str();
+    if (const int error = getaddrinfo(host, port.c_str(), &hints, &addresses); error != 0) {
+        throw runtime_error("Cannot resolve "s + endpoint.host + ": "s + gai_strerror(error));
+    }
+    int result = -1;
+    int last_errno = 0;
+    for (addrinfo *address = addresses; address && result < 0; address = address->ai_next) {
+        const int fd = socket(address->ai_family, address->ai_socktype | SOCK_CLOEXEC, address->ai_protocol);
+        if (fd < 0) {
+            last_errno = errno;
+            continue;
+        }
+        if (action(fd, address->ai_addr, address->ai_addrlen)) {
+            result = fd;
+        } else {
+            last_errno = errno;
+            close(fd);
+        }
+    }
+    freeaddrinfo(addresses);
+    errno = last_errno;
+    return result;
+}
+
+void SetNoDelay(int fd) {
+    const int enable = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &enable, sizeof(enable));
+}
+}
+
+QueryEndpoint ParseQueryEndpoint(const std::string &endpoint) {
+    QueryEndpoint result;
+    if (endpoint.rfind("unix:"s, 0) == 0) {
+        result.is_unix = true;
+        result.path = endpoint.substr(5);
+        if (result.path.empty()) {
+            throw invalid_argument("Empty unix socket path"s);
+        }
+        return result;
+    }
+    const size_t colon = endpoint.rfind(':');
+    if (colon == string::npos) {
+        throw invalid_argument("Endpoint must be unix:PATH or HOST:PORT: "s + endpoint);
+    }
+    result.host = endpoint.substr(0, colon);
+    const char *port_begin = endpoint.data() + colon + 1;
+    const char *port_end = endpoint.data() + endpoint.size();
+    const auto parsed = from_chars(port_begin, port_end, result.port);
+    if (parsed.ec != errc() || parsed.ptr != port_end || port_begin == port_end) {
+        throw invalid_argument("Invalid port in endpoint: "s + endpoint);
+    }
+    return result;
+}
+
+int OpenListeningSocket(const QueryEndpoint &endpoint) {
+    int fd = -1;
+    if (endpoint.is_unix) {
+        const sockaddr_un address = MakeUnixAddress(endpoint.path);
+        fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        if (fd < 0) {
+            ThrowSystemError("socket"s);
+        }
+        // Сокет от предыдущего запуска мешает bind. Удаляется только сокет: путь к обычному файлу
+        // по ошибке не должен стоить этого файла
+        struct stat existing{};
+        if (lstat(endpoint.path.c_str(), &existing) == 0) {
+            if (!S_ISSOCK(existing.st_mode)) {
+                close(fd);
+                throw runtime_error("Cannot listen on "s + endpoint.path + ": file exists and is not a socket"s);
+            }
+            unlink(endpoint.path.c_str());
+        }
+        if (bind(fd, reinterpret_cast<const sockaddr *>(&address), sizeof(address)) != 0) {
+            const int error = errno;
+            close(fd);
+            errno = error;
+            ThrowSystemError("Cannot bind "s + endpoint.path);
+        }
+    } else {
+        fd = ForEachTcpAddress(endpoint, AI_PASSIVE, [](int fd, const sockaddr *address, socklen_t length) {
+            const int enable = 1;
+            setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &enable, sizeof(enable));
+            return bind(fd, address, length) == 0;
+        });
+        if (fd < 0) {
+            ThrowSystemError("Cannot bind "s + endpoint.host + ":"s + to_string(endpoint.port));
+        }
+    }
+    if (listen(fd, SOMAXCONN) != 0 || fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK) != 0) {
+        const int error = errno;
+        close(fd);
+        errno = error;
+        ThrowSystemError("listen"s);
+    }
+    return fd;
+}
+
+int ConnectToEndpoint(const QueryEndpoint &endpoint) {
+    if (endpoint.is_unix) {
+        const sockaddr_un address = MakeUnixAddress(endpoint.path);
+        const int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        if (fd < 0) {
+            ThrowSystemError("socket"s);
+        }
+        if (connect(fd, reinterpret_cast<const sockaddr *>(&address), sizeof(address)) != 0) {
+            const int error = errno;
+            close(fd);
+            errno = error;
+            ThrowSystemError("Cannot connect to "s + endpoint.path);
+        }
+        return fd;
+    }
+    const int fd = ForEachTcpAddress(endpoint, 0, [](int fd, const sockaddr *address, socklen_t length) {
+        return connect(fd, address, length) == 0;
+    });
+    if (fd < 0) {
+        ThrowSystemError("Cannot connect to "s + endpoint.host + ":"s + to_string(endpoint.port));
+    }
+    SetNoDelay(fd);
+    return fd;
+}
+
+uint16_t GetBoundPort(int socket_fd) {
+    sockaddr_storage address{};
+    socklen_t length = sizeof(address);
+    if (getsockname(socket_fd, reinterpret_cast<sockaddr *>(&address), &length) != 0) {
+        ThrowSystemError("getsockname"s);
+    }
+    if (address.ss_family == AF_INET) {
+        return ntohs(reinterpret_cast<const sockaddr_in *>(&address)->sin_port);
+    }
+    if (address.ss_family == AF_INET6) {
+        return ntohs(reinterpret_cast<const sockaddr_in6 *>(&address)->sin6_port);
+    }
+    return 0;
+}
@@ -0,0 +1,25 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+// Адрес сервиса запросов: "unix:/path/to/socket" или "host:port" для TCP.
+// Порт 0 при прослушивании означает свободный порт, выбранный системой
+struct QueryEndpoint {
+    bool is_unix = false;
+    std::string path;
+    std::string host;
+    uint16_t port = 0;
+};
+
+// Бросает std::invalid_argument на некорректной записи
+QueryEndpoint ParseQueryEndpoint(const std::string &endpoint);
+
+// Открывают сокет и возвращают дескриптор; при ошибке бросают std::runtime_error.
+// Слушающий сокет неблокирующий, клиентский — блокирующий
+int OpenListeningSocket(const QueryEndpoint &endpoint);
+
+int ConnectToEndpoint(const QueryEndpoint &endpoint);
+
+// Порт, к которому фактически привязан TCP-сокет
+uint16_t GetBoundPort(int socket_fd);
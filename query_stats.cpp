@@ -0,0 +1,292 @@
+#include "query_stats.h"
+
+#include <algorithm>
+#include <functional>
+#include <limits>
+#include <map>
+#include <numeric>
+#include <stdexcept>
+
+using namespace std;
+
+namespace {
+uint64_t MixHash(uint64_t value) {
+    // splitmix64: разные строки скетча получают независимые хеши из одного std::hash
+    value += 0x9E3779B97F4A7C15ULL;
+    value = (value ^ (value >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    value = (value ^ (value >> 27)) * 0x94D049BB133111EBULL;
+    return value ^ (value >> 31);
+}
+
+void UpdateMax(atomic<uint64_t>& target, uint64_t value) {
+    uint64_t current = target.load(memory_order_relaxed);
+    while (current < value && !target.compare_exchange_weak(current, value, memory_order_relaxed)) {
+    }
+}
+}
+
+QueryStats::QueryStats(std::chrono::seconds slot_duration, size_t slot_count)
+        : slot_duration_(slot_duration)
+        , slots_(new Slot[slot_count])
+        , slot_count_(slot_count) {
+    if (slot_duration.count() <= 0 || slot_count == 0) {
+        throw invalid_argument("Statistics window must be non-empty"s);
+    }
+}
+
+void QueryStats::Record(std::string_view query, bool empty_result, std::chrono::nanoseconds latency) {
+    RecordRequest(query, empty_result, false, latency);
+}
+
+void QueryStats::RecordFailure(std::string_view query, std::chrono::nanoseconds latency) {
+    RecordRequest(query, false, true, latency);
+}
+
+void QueryStats::RecordRequest(std::string_view query, bool empty_result, bool failed,
+                               std::chrono::nanoseconds latency) {
+    const int64_t epoch = CurrentEpoch();
+    Slot& slot = slots_[static_cast<size_t>(epoch) % slot_count_];
+
+    int64_t seen = slot.epoch.load(memory_order_acquire);
+    if (seen < epoch && slot.epoch.compare_exchange_strong(seen, epoch, memory_order_acq_rel)) {
+        // Интервал переиспользуется по кругу. Записи, сделанные другими потоками в момент сброса,
+        // могут потеряться — для статистики это допустимо
+        for (auto& counters: slot.counters) {
+            counters.requests.store(0, memory_order_relaxed);
+            counters.no_result_requests.store(0, memory_order_relaxed);
+            counters.failed_requests.store(0, memory_order_relaxed);
+            counters.max_latency_ns.store(0, memory_order_relaxed);
+        }
+        for (auto& bucket: slot.latency_buckets) {
+            bucket.store(0, memory_order_relaxed);
+        }
+        for (auto& cell: slot.sketch) {
+            cell.store(0, memory_order_relaxed);
+        }
+        for (auto& query_hash: slot.heavy_hitters.hashes) {
+            query_hash.store(0, memory_order_relaxed);
+        }
+        slot.heavy_hitters.min_estimate.store(0, memory_order_relaxed);
+    }
+
+    const uint64_t latency_ns = static_cast<uint64_t>(max<int64_t>(latency.count(), 0));
+    Counters& counters = slot.counters[StripeIndex()];
+    counters.requests.fetch_add(1, memory_order_relaxed);
+    if (empty_result) {
+        counters.no_result_requests.fetch_add(1, memory_order_relaxed);
+    }
+    if (failed) {
+        counters.failed_requests.fetch_add(1, memory_order_relaxed);
+    }
+    UpdateMax(counters.max_latency_ns, latency_ns);
+    slot.latency_buckets[BucketIndex(latency_ns)].fetch_add(1, memory_order_relaxed);
+
+    const uint64_t query_hash = QueryHash(query);
+    const uint64_t estimate = UpdateSketch(slot, query_hash);
+    HeavyHitters& heavy_hitters = slot.heavy_hitters;
+    if (estimate <= heavy_hitters.min_estimate.load(memory_order_relaxed)) {
+        return;
+    }
+    for (const auto& candidate: heavy_hitters.hashes) {
+        if (candidate.load(memory_order_relaxed) == query_hash) {
+            return;
+        }
+    }
+    UpdateHeavyHitters(slot, epoch, query, query_hash, estimate);
+}
+
+QueryStats::Snapshot QueryStats::GetSnapshot(std::chrono::seconds window, size_t top_count) const {
+    using namespace std::chrono;
+
+    const int64_t epoch = CurrentEpoch();
+    const int64_t window_slots = min<int64_t>(
+            max<int64_t>((duration_cast<Clock::duration>(window) + slot_duration_ - Clock::duration(1)) / slot_duration_, 1),
+            static_cast<int64_t>(slot_count_));
+
+    Snapshot snapshot;
+    snapshot.window = duration_cast<seconds>(slot_duration_ * window_slots);
+    vector<uint64_t> buckets(BUCKET_COUNT);
+    uint64_t max_latency_ns = 0;
+    map<string, uint64_t, less<>> query_counts;
+    for (size_t i = 0; i < slot_count_; ++i) {
+        const Slot& slot = slots_[i];
+        const int64_t slot_epoch = slot.epoch.load(memory_order_acquire);
+        if (slot_epoch > epoch || slot_epoch <= epoch - window_slots) {
+            continue;
+        }
+        for (const auto& counters: slot.counters) {
+            snapshot.requests += counters.requests.load(memory_order_relaxed);
+            snapshot.no_result_requests += counters.no_result_requests.load(memory_order_relaxed);
+            snapshot.failed_requests += counters.failed_requests.load(memory_order_relaxed);
+            max_latency_ns = max(max_latency_ns, counters.max_latency_ns.load(memory_order_relaxed));
+        }
+        for (size_t j = 0; j < BUCKET_COUNT; ++j) {
+            buckets[j] += slot.latency_buckets[j].load(memory_order_relaxed);
+        }
+        if (top_count == 0) {
+            continue;
+        }
+        // Запрос, не попавший в кандидаты интервала, был в нём редким: его вклад в окно не учитывается
+        lock_guard guard(slot.heavy_hitters.mutex);
+        if (slot.heavy_hitters.epoch != slot_epoch) {
+            continue;
+        }
+        for (size_t j = 0; j < HEAVY_HITTER_COUNT; ++j) {
+            const uint64_t query_hash = slot.heavy_hitters.hashes[j].load(memory_order_relaxed);
+            if (query_hash != 0) {
+                query_counts[slot.heavy_hitters.queries[j]] += GetEstimate(slot, query_hash);
+            }
+        }
+    }
+
+    const double elapsed = duration<double>(min(Clock::now() - start_time_, slot_duration_ * window_slots)).count();
+    snapshot.queries_per_second = elapsed > 0 ? snapshot.requests / elapsed : 0.0;
+    snapshot.empty_result_rate = snapshot.requests ? snapshot.no_result_requests * 1.0 / snapshot.requests : 0.0;
+    snapshot.error_rate = snapshot.requests ? snapshot.failed_requests * 1.0 / snapshot.requests : 0.0;
+    snapshot.latency_max = nanoseconds(max_latency_ns);
+
+    const uint64_t total = accumulate(buckets.begin(), buckets.end(), uint64_t{0});
+    const auto percentile = [&buckets, total, max_latency_ns](double fraction) {
+        const auto rank = static_cast<uint64_t>(fraction * total);
+        uint64_t seen = 0;
+        for (size_t i = 0; i < buckets.size(); ++i) {
+            seen += buckets[i];
+            if (seen > rank) {
+                return nanoseconds(min(BucketUpperBound(i), max_latency_ns));
+            }
+        }
+        return nanoseconds(max_latency_ns);
+    };
+    if (total > 0) {
+        snapshot.latency_p50 = percentile(0.5);
+        snapshot.latency_p90 = percentile(0.9);
+        snapshot.latency_p99 = percentile(0.99);
+        snapshot.latency_p999 = percentile(0.999);
+    }
+
+    if (top_count > 0) {
+        snapshot.top_queries.assign(query_counts.begin(), query_counts.end());
+        const size_t count = min(top_count, snapshot.top_queries.size());
+        partial_sort(snapshot.top_queries.begin(), snapshot.top_queries.begin() + count, snapshot.top_queries.end(),
+                     [](const auto& lhs, const auto& rhs) {
+                         return lhs.second > rhs.second;
+                     });
+        snapshot.top_queries.resize(count);
+    }
+    return snapshot;
+}
+
+QueryStats::Snapshot QueryStats::GetSnapshot() const {
+    return GetSnapshot(std::chrono::duration_cast<std::chrono::seconds>(slot_duration_ * slot_count_));
+}
+
+uint64_t QueryStats::GetNoResultRequests() const {
+    return GetSnapshot(std::chrono::duration_cast<std::chrono::seconds>(slot_duration_ * slot_count_), 0)
+            .no_result_requests;
+}
+
+int64_t QueryStats::CurrentEpoch() const {
+    return (Clock::now() - start_time_) / slot_duration_;
+}
+
+size_t QueryStats::StripeIndex() {
+    // Потоки получают полосы по кругу: первые STRIPE_COUNT потоков не делят строки кэша друг с другом
+    static atomic<size_t> next_index{0};
+    static thread_local const size_t index = next_index.fetch_add(1, memory_order_relaxed) % STRIPE_COUNT;
+    return index;
+}
+
+size_t QueryStats::BucketIndex(uint64_t value) {
+    if (value < SUB_BUCKET_COUNT) {
+        return static_cast<size_t>(value);
+    }
+    const int most_significant_bit = 63 - __builtin_clzll(value);
+    const size_t octave = most_significant_bit - SUB_BUCKET_BITS + 1;
+    const size_t sub_bucket = (value >> (most_significant_bit - SUB_BUCKET_BITS)) & (SUB_BUCKET_COUNT - 1);
+    return min(octave * SUB_BUCKET_COUNT + sub_bucket, BUCKET_COUNT - 1);
+}
+
+uint64_t QueryStats::BucketUpperBound(size_t index) {
+    const size_t octave = index / SUB_BUCKET_COUNT;
+    const uint64_t sub_bucket = index % SUB_BUCKET_COUNT;
+    if (octave == 0) {
+        return sub_bucket + 1;
+    }
+    return (SUB_BUCKET_COUNT + sub_bucket + 1) << (octave - 1);
+}
+
+uint64_t QueryStats::QueryHash(std::string_view query) {
+    // 0 помечает свободное место среди кандидатов
+    const uint64_t query_hash = hash<string_view>{}(query);
+    return query_hash != 0 ? query_hash : 1;
+}
+
+uint64_t QueryStats::UpdateSketch(Slot& slot, uint64_t query_hash) {
+    uint64_t estimate = numeric_limits<uint64_t>::max();
+    for (size_t row = 0; row < SKETCH_DEPTH; ++row) {
+        const size_t column = MixHash(query_hash + row) % SKETCH_WIDTH;
+        const uint64_t count = slot.sketch[row * SKETCH_WIDTH + column].fetch_add(1, memory_order_relaxed) + 1;
+        estimate = min(estimate, count);
+    }
+    return estimate;
+}
+
+uint64_t QueryStats::GetEstimate(const Slot& slot, uint64_t query_hash) {
+    uint64_t estimate = numeric_limits<uint64_t>::max();
+    for (size_t row = 0; row < SKETCH_DEPTH; ++row) {
+        const size_t column = MixHash(query_hash + row) % SKETCH_WIDTH;
+        estimate = min<uint64_t>(estimate, slot.sketch[row * SKETCH_WIDTH + column].load(memory_order_relaxed));
+    }
+    return estimate;
+}
+
+void QueryStats::UpdateHeavyHitters(Slot& slot, int64_t epoch, std::string_view query, uint64_t query_hash,
+                                    uint64_t estimate) {
+    HeavyHitters& heavy_hitters = slot.heavy_hitters;
+    lock_guard guard(heavy_hitters.mutex);
+    if (heavy_hitters.epoch > epoch) {
+        // Запись опоздала: интервал уже занят следующим кругом кольца
+        return;
+    }
+    if (heavy_hitters.epoch != epoch) {
+        heavy_hitters.queries.fill({});
+        heavy_hitters.epoch = epoch;
+    }
+
+    // Пока мьютекс ждали, запрос мог стать кандидатом в другом потоке
+    size_t target = HEAVY_HITTER_COUNT;
+    for (size_t i = 0; i < HEAVY_HITTER_COUNT; ++i) {
+        const uint64_t candidate = heavy_hitters.hashes[i].load(memory_order_relaxed);
+        if (candidate == query_hash) {
+            return;
+        }
+        if (candidate == 0 && target == HEAVY_HITTER_COUNT) {
+            target = i;
+        }
+    }
+    if (target == HEAVY_HITTER_COUNT) {
+        // Оценки кандидатов растут, поэтому min_estimate — устаревшая нижняя граница: сравниваем с текущими
+        uint64_t rarest_estimate = numeric_limits<uint64_t>::max();
+        for (size_t i = 0; i < HEAVY_HITTER_COUNT; ++i) {
+            const uint64_t candidate_estimate = GetEstimate(slot, heavy_hitters.hashes[i].load(memory_order_relaxed));
+            if (candidate_estimate < rarest_estimate) {
+                rarest_estimate = candidate_estimate;
+                target = i;
+            }
+        }
+        if (estimate <= rarest_estimate) {
+            heavy_hitters.min_estimate.store(rarest_estimate, memory_order_relaxed);
+            return;
+        }
+    }
+    heavy_hitters.queries[target] = query;
+    heavy_hitters.hashes[target].store(query_hash, memory_order_relaxed);
+
+    uint64_t min_estimate = numeric_limits<uint64_t>::max();
+    for (const auto& candidate: heavy_hitters.hashes) {
+        const uint64_t candidate_hash = candidate.load(memory_order_relaxed);
+        // Пока есть свободные места, кандидатом становится любой новый запрос
+        min_estimate = min(min_estimate, candidate_hash != 0 ? GetEstimate(slot, candidate_hash) : 0);
+    }
+    heavy_hitters.min_estimate.store(min_estimate, memory_order_relaxed);
+}
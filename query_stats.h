@@ -0,0 +1,114 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Статистика запросов в скользящем окне реального времени.
+// Память фиксирована: кольцо из slot_count интервалов длиной slot_duration, в каждом — счётчики,
+// разнесённые по потокам, и логарифмическая гистограмма задержек (как в HdrHistogram).
+// Частые запросы тоже считаются по интервалам: в каждом свой атомарный count-min скетч и HEAVY_HITTER_COUNT
+// запросов-кандидатов. Кандидаты меняются, только когда оценка нового запроса превышает минимальную оценку
+// среди них; снимок берёт объединение кандидатов окна и складывает их оценки по скетчам всех его интервалов.
+// Record можно вызывать из нескольких потоков одновременно без блокировок: мьютекс кандидатов берётся
+// лишь при смене состава и при снимке
+class QueryStats {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    struct Snapshot {
+        std::chrono::seconds window{0};
+        uint64_t requests = 0;
+        uint64_t no_result_requests = 0;
+        // Запросы, завершившиеся ошибкой; в no_result_requests они не входят
+        uint64_t failed_requests = 0;
+        double queries_per_second = 0.0;
+        double empty_result_rate = 0.0;
+        double error_rate = 0.0;
+        std::chrono::nanoseconds latency_p50{0};
+        std::chrono::nanoseconds latency_p90{0};
+        std::chrono::nanoseconds latency_p99{0};
+        std::chrono::nanoseconds latency_p999{0};
+        std::chrono::nanoseconds latency_max{0};
+        std::vector<std::pair<std::string, uint64_t>> top_queries;
+    };
+
+    explicit QueryStats(std::chrono::seconds slot_duration = std::chrono::seconds(60), size_t slot_count = 1440);
+
+    void Record(std::string_view query, bool empty_result, std::chrono::nanoseconds latency);
+
+    // Запрос, на который вместо результата вернулась ошибка (неверный синтаксис, неизвестный документ)
+    void RecordFailure(std::string_view query, std::chrono::nanoseconds latency);
+
+    // window обрезается до полного размера кольца
+    [[nodiscard]] Snapshot GetSnapshot(std::chrono::seconds window, size_t top_count = 10) const;
+
+    [[nodiscard]] Snapshot GetSnapshot() const;
+
+    [[nodiscard]] uint64_t GetNoResultRequests() const;
+
+private:
+    static constexpr size_t STRIPE_COUNT = 8;
+    static constexpr int SUB_BUCKET_BITS = 3;
+    static constexpr size_t SUB_BUCKET_COUNT = size_t{1} << SUB_BUCKET_BITS;
+    static constexpr size_t BUCKET_COUNT = 41 * SUB_BUCKET_COUNT;
+    static constexpr size_t SKETCH_DEPTH = 4;
+    static constexpr size_t SKETCH_WIDTH = 256;
+    static constexpr size_t HEAVY_HITTER_COUNT = 32;
+
+    struct alignas(64) Counters {
+        std::atomic<uint64_t> requests{0};
+        std::atomic<uint64_t> no_result_requests{0};
+        std::atomic<uint64_t> failed_requests{0};
+        std::atomic<uint64_t> max_latency_ns{0};
+    };
+
+    struct HeavyHitters {
+        // Хеши кандидатов (0 — свободное место) и нижняя граница их оценок читаются без блокировки:
+        // запрос, который уже в кандидатах или реже их всех, мьютекс не трогает
+        std::array<std::atomic<uint64_t>, HEAVY_HITTER_COUNT> hashes{};
+        std::atomic<uint64_t> min_estimate{0};
+        std::mutex mutex;
+        // Интервал, к которому относятся queries; кандидаты прошлого круга очищаются при первой смене состава
+        int64_t epoch = -1;
+        std::array<std::string, HEAVY_HITTER_COUNT> queries;
+    };
+
+    struct Slot {
+        std::atomic<int64_t> epoch{-1};
+        std::array<Counters, STRIPE_COUNT> counters;
+        std::array<std::atomic<uint32_t>, BUCKET_COUNT> latency_buckets{};
+        std::array<std::atomic<uint32_t>, SKETCH_DEPTH * SKETCH_WIDTH> sketch{};
+        mutable HeavyHitters heavy_hitters;
+    };
+
+    const Clock::duration slot_duration_;
+    const Clock::time_point start_time_ = Clock::now();
+    std::unique_ptr<Slot[]> slots_;
+    const size_t slot_count_;
+
+    [[nodiscard]] int64_t CurrentEpoch() const;
+
+    void RecordRequest(std::string_view query, bool empty_result, bool failed, std::chrono::nanoseconds latency);
+
+    static size_t StripeIndex();
+
+    static size_t BucketIndex(uint64_t value);
+
+    static uint64_t BucketUpperBound(size_t index);
+
+    static uint64_t QueryHash(std::string_view query);
+
+    static uint64_t UpdateSketch(Slot& slot, uint64_t query_hash);
+
+    static uint64_t GetEstimate(const Slot& slot, uint64_t query_hash);
+
+    static void UpdateHeavyHitters(Slot& slot, int64_t epoch, std::string_view query, uint64_t query_hash,
+                                   uint64_t estimate);
+};
@@ -0,0 +1,95 @@
+#include "ranking.h"
+
+#include <algorithm>
+#include <thread>
+
+using namespace std;
+
+namespace {
+// Меньше этого блоки не выгодно раздавать потокам
+const size_t PARALLEL_RANKING_BLOCK = 16384;
+
+struct RankedPosition {
+    RankKey key;
+    uint32_t position;
+};
+
+bool RanksHigher(const RankedPosition &lhs, const RankedPosition &rhs) {
+    return lhs.key > rhs.key;
+}
+
+vector<RankedPosition> SelectTopPositions(const vector<Document> &documents, size_t begin, size_t end,
+                                          size_t top_count) {
+    vector<RankedPosition> ranked(end - begin);
+    for (size_t i = begin; i < end; ++i) {
+        ranked[i - begin] = {MakeRankKey(documents[i].relevance, documents[i].rating, documents[i].id),
+                             static_cast<uint32_t>(i)};
+    }
+    if (ranked.size() > top_count) {
+        nth_element(ranked.begin(), ranked.begin() + static_cast<ptrdiff_t>(top_count), ranked.end(), RanksHigher);
+        ranked.resize(top_count);
+    }
+    sort(ranked.begin(), ranked.end(), RanksHigher);
+    return ranked;
+}
+
+void GatherDocuments(vector<Document> &documents, const vector<RankedPosition> &ranked) {
+    vector<Document> result;
+    result.reserve(ranked.size());
+    for (const RankedPosition &item: ranked) {
+        result.push_back(documents[item.position]);
+    }
+    documents = move(result);
+}
+}
+
+void RankTopDocuments(std::vector<Document> &documents, size_t top_count) {
+    GatherDocuments(documents, SelectTopPositions(documents, 0, documents.size(), top_count));
+}
+
+void RankTopDocuments(const std::execution::parallel_policy &, std::vector<Document> &documents,
+                      size_t top_count) {
+    const size_t block_count = min<size_t>(max(1u, thread::hardware_concurrency()),
+                                           documents.size() / PARALLEL_RANKING_BLOCK);
+    if (block_count < 2) {
+        RankTopDocuments(documents, top_count);
+        return;
+    }
+
+    vector<vector<RankedPosition>> blocks(block_count);
+    vector<size_t> block_indexes(block_count);
+    for (size_t i = 0; i < block_count; ++i) {
+        block_indexes[i] = i;
+    }
+    for_each(execution::par, block_indexes.begin(), block_indexes.end(), [&](size_t block) {
+        const size_t begin = documents.size() * block / block_count;
+        const size_t end = documents.size() * (block + 1) / block_count;
+        blocks[block] = SelectTopPositions(documents, begin, end, top_count);
+    });
+
+    // Слияние отсортированных блоков через кучу их текущих голов
+    vector<size_t> heads(block_count, 0);
+    const auto lower_head = [&](size_t lhs, size_t rhs) {
+        return RanksHigher(blocks[rhs][heads[rhs]], blocks[lhs][heads[lhs]]);
+    };
+    vector<size_t> heap;
+    for (size_t block = 0; block < block_count; ++block) {
+        if (!blocks[block].empty()) {
+            heap.push_back(block);
+        }
+    }
+    make_heap(heap.begin(), heap.end(), lower_head);
+    vector<RankedPosition> merged;
+    merged.reserve(top_count);
+    while (!heap.empty() && merged.size() < top_count) {
+        pop_heap(heap.begin(), heap.end(), lower_head);
+        const size_t block = heap.back();
+        merged.push_back(blocks[block][heads[block]]);
+        if (++heads[block] < blocks[block].size()) {
+            push_heap(heap.begin(), heap.end(), lower_head);
+        } else {
+            heap.pop_back();
+        }
+    }
+    GatherDocuments(documents, merged);
+}
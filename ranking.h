@@ -0,0 +1,46 @@
+#pragma once
+
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <execution>
+#include <vector>
+
+#include "document.h"
+
+// Релевантности, отличающиеся меньше чем на RELEVANCE_EPSILON, считаются равными, и выше идёт документ
+// с большим рейтингом
+const double RELEVANCE_EPSILON = 1e-6;
+
+// Ключ ранжирования — одно 128-битное беззнаковое число: старшие 64 бита — релевантность в единицах
+// RELEVANCE_EPSILON, затем 32 бита рейтинга и 32 бита инвертированного id. Знаковые поля смещены на половину
+// диапазона, поэтому больший ключ означает более высокую позицию, а сравнение — одно целочисленное сравнение
+// без ветвлений. При полном равенстве выше меньший id, так что порядок не зависит от порядка кандидатов.
+// Старший блок вмещает релевантности до ~4.6e12, поэтому усиленные полями и ^boost запросы упорядочены
+// по релевантности, а не только по рейтингу.
+// Старый компаратор с |a - b| < EPSILON не был строгим слабым порядком, и для цепочек почти равных
+// релевантностей результат std::sort не был определён. Сетка даёт тот же порядок, кроме пар, которые
+// отличаются меньше чем на EPSILON, но лежат по разные стороны границы ячейки: они сравниваются
+// по релевантности. Отклонение ограничено EPSILON: переставленные документы отличаются по релевантности
+// меньше чем на 1e-6 (проверяется в main.cpp)
+using RankKey = unsigned __int128;
+
+inline RankKey MakeRankKey(double relevance, int rating, int id) {
+    // Предел с запасом меньше 2^63, чтобы приведение к int64_t было определено; NaN попадает в нижнюю ячейку
+    const double bucket_limit = 4611686018427387904.0;
+    const double bucket = std::floor(relevance / RELEVANCE_EPSILON);
+    const double clamped = bucket > -bucket_limit ? std::fmin(bucket, bucket_limit) : -bucket_limit;
+    const uint64_t relevance_bits = static_cast<uint64_t>(static_cast<int64_t>(clamped)) ^ (uint64_t{1} << 63);
+    const uint64_t rating_bits = static_cast<uint32_t>(rating) ^ 0x80000000u;
+    const uint64_t id_bits = ~(static_cast<uint32_t>(id) ^ 0x80000000u);
+    return (RankKey{relevance_bits} << 64) | (rating_bits << 32) | id_bits;
+}
+
+// Оставляет в documents top_count лучших по ключу ранжирования, упорядоченных сверху вниз.
+// Выбор через nth_element по массиву ключей, сортируются только top_count выбранных
+void RankTopDocuments(std::vector<Document> &documents, size_t top_count);
+
+// Кандидаты делятся на блоки, лучшие top_count каждого блока выбираются параллельно
+// и сливаются k-путевым слиянием. Результат совпадает с последовательной версией
+void RankTopDocuments(const std::execution::parallel_policy &policy, std::vector<Document> &documents,
+                      size_t top_count);
@@ -3,17 +3,19 @@
 using namespace std;
 
 std::vector<Document> RequestQueue::AddFindRequest(const std::string& raw_query, DocumentStatus status) {
-    vector<Document> result = search_server_.FindTopDocuments(raw_query, status);
-    UpdateRequests({raw_query, result.empty()});
-    return result;
+    return AddFindRequest(raw_query, [status](int, DocumentStatus document_status, int) {
+        return document_status == status;
+    });
 }
 
 std::vector<Document> RequestQueue::AddFindRequest(const std::string& raw_query) {
-    vector<Document> result = search_server_.FindTopDocuments(raw_query);
-    UpdateRequests({raw_query, result.empty()});
-    return result;
+    return AddFindRequest(raw_query, DocumentStatus::ACTUAL);
 }
 
 int RequestQueue::GetNoResultRequests() const {
-    return no_result_requests_;
+    return static_cast<int>(stats_.GetNoResultRequests());
+}
+
+QueryStats::Snapshot RequestQueue::GetStats(std::chrono::seconds window, size_t top_count) const {
+    return stats_.GetSnapshot(window, top_count);
 }
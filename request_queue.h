@@ -1,22 +1,27 @@
 #pragma once
 
+#include <chrono>
+#include <string>
 #include <vector>
-#include <deque>
 
 #include "search_server.h"
 #include "document.h"
+#include "query_stats.h"
 
 class RequestQueue {
 public:
     explicit RequestQueue(const SearchServer& search_server)
-        : search_server_(search_server) {
+        : search_server_(search_server)
+        , stats_(std::chrono::seconds(60), min_in_day_) {
     }
 
-    // сделаем "обёртки" для всех методов поиска, чтобы сохранять результаты для нашей статистики
+    // сделаем "обёртки" для всех методов поиска, чтобы сохранять результаты для нашей статистики.
+    // Обёртки можно вызывать из нескольких потоков, например из ProcessQueries
     template <typename DocumentPredicate>
     std::vector<Document> AddFindRequest(const std::string& raw_query, const DocumentPredicate& document_predicate) {
+        const auto start_time = QueryStats::Clock::now();
         std::vector<Document> result = search_server_.FindTopDocuments(raw_query, document_predicate);
-        UpdateRequests({raw_query, result.empty()});
+        stats_.Record(raw_query, result.empty(), QueryStats::Clock::now() - start_time);
         return result;
     }
 
@@ -24,34 +29,14 @@ public:
 
     std::vector<Document> AddFindRequest(const std::string& raw_query);
 
+    // Запросы без результатов за последние сутки
     int GetNoResultRequests() const;
 
+    QueryStats::Snapshot GetStats(std::chrono::seconds window, size_t top_count = 10) const;
+
 private:
-    struct QueryResult {
-        std::string query;
-        bool empty;
-    };
-    std::deque<QueryResult> requests_;
-    const static int sec_in_day_ = 1440;
+    // Сутки хранятся поминутно
+    const static int min_in_day_ = 1440;
     const SearchServer& search_server_;
-    int no_result_requests_ = 0;
-
-    void UpdateRequests(const QueryResult& result) {
-        requests_.push_back(result);
-        if (result.empty) {
-            ++no_result_requests_;
-        }
-        RemoveOutdatedRequests();
-    }
-
-    void RemoveOutdatedRequests() {
-        int64_t need_to_remove = static_cast<int64_t>(requests_.size()) - sec_in_day_;
-        while (need_to_remove > 0) {
-            if (requests_.front().empty) {
-                --no_result_requests_;
-            }
-            requests_.pop_front();
-            --need_to_remove;
-        }
-    }
+    QueryStats stats_;
 };
@@ -1,28 +1,208 @@
 #include "search_server.h"
 
+#include <bit>
+#include <charconv>
+#include <iterator>
+
 using namespace std;
 
 void SearchServer::AddDocument(int document_id, const std::string_view document, DocumentStatus status, const std::vector<int>& ratings) {
     if ((document_id < 0) || (documents_.count(document_id) > 0)) {
         throw invalid_argument("Invalid document_id"s);
     }
-    const auto words = SplitIntoWordsNoStop(document);
+    IndexTokenizedDocument(document_id, SplitIntoWordsNoStop(document), status, ratings, nullopt);
+}
+
+std::optional<int> SearchServer::AddTokenizedDocument(int document_id, const std::vector<std::string_view>& words,
+                                                      DocumentStatus status, const std::vector<int>& ratings,
+                                                      std::optional<uint64_t> fingerprint) {
+    // Слово с FIELD_SEPARATOR выдало бы себя за слово поля, поэтому внешние слова проверяются до индексации
+    for (const string_view word: words) {
+        if (word.empty() || !IsValidWord(word)) {
+            throw invalid_argument("Word "s + string{word} + " is invalid"s);
+        }
+    }
+    const auto is_stop_word = [this](string_view word) {
+        return IsStopWord(word);
+    };
+    if (none_of(words.begin(), words.end(), is_stop_word)) {
+        return IndexTokenizedDocument(document_id, words, status, ratings, fingerprint);
+    }
+    vector<string_view> filtered;
+    filtered.reserve(words.size());
+    remove_copy_if(words.begin(), words.end(), back_inserter(filtered), is_stop_word);
+    return IndexTokenizedDocument(document_id, filtered, status, ratings, nullopt);
+}
+
+std::optional<int> SearchServer::IndexTokenizedDocument(int document_id, const std::vector<std::string_view>& words,
+                                                        DocumentStatus status, const std::vector<int>& ratings,
+                                                        std::optional<uint64_t> fingerprint) {
+    TRACE_STAGE(ADD_DOCUMENT);
+    if ((document_id < 0) || (documents_.count(document_id) > 0)) {
+        throw invalid_argument("Invalid document_id"s);
+    }
+    optional<int> duplicate;
+    if (fingerprints_) {
+        if (!fingerprint) {
+            fingerprint = ComputeTermSetFingerprint(words);
+        }
+        duplicate = ResolveDuplicate(*fingerprint);
+        if (duplicate && duplicate_policy_ == DuplicatePolicy::KEEP_FIRST) {
+            return duplicate;
+        }
+    }
+    IndexFieldWords(document_id, DEFAULT_FIELD, words);
+    FinishDocument(document_id, status, ratings, words.size(), fingerprint.value_or(0));
+    return duplicate;
+}
+
+void SearchServer::AddDocument(int document_id, const std::vector<DocumentField>& fields, DocumentStatus status,
+                               const std::vector<int>& ratings) {
+    TRACE_STAGE(ADD_DOCUMENT);
+    if ((document_id < 0) || (documents_.count(document_id) > 0)) {
+        throw invalid_argument("Invalid document_id"s);
+    }
+    // Всё проверяется до изменения индекса, чтобы некорректный документ не попал в него частично
+    vector<vector<string_view>> field_words;
+    field_words.reserve(fields.size());
+    set<string_view> names;
+    for (const DocumentField& field: fields) {
+        if (!IsValidFieldName(field.name) || !names.insert(field.name).second) {
+            throw invalid_argument("Invalid field name "s + string{field.name});
+        }
+        field_words.push_back(SplitIntoWordsNoStop(field.text));
+    }
+
+    uint64_t fingerprint = 0;
+    if (fingerprints_) {
+        TermSetFingerprint term_set;
+        string prefix;
+        for (size_t i = 0; i < fields.size(); ++i) {
+            prefix.clear();
+            if (fields[i].name != DEFAULT_FIELD) {
+                prefix.assign(fields[i].name).append(1, FIELD_SEPARATOR);
+            }
+            term_set.Add(field_words[i], prefix);
+        }
+        fingerprint = term_set.Get();
+        if (ResolveDuplicate(fingerprint) && duplicate_policy_ == DuplicatePolicy::KEEP_FIRST) {
+            return;
+        }
+    }
 
+    size_t word_count = 0;
+    for (size_t i = 0; i < fields.size(); ++i) {
+        field_weights_.emplace(fields[i].name, 1.0);
+        IndexFieldWords(document_id, fields[i].name, field_words[i]);
+        word_count += field_words[i].size();
+    }
+    FinishDocument(document_id, status, ratings, word_count, fingerprint);
+}
+
+std::optional<int> SearchServer::ResolveDuplicate(uint64_t fingerprint) {
+    const optional<int> duplicate = fingerprints_->Find(fingerprint);
+    if (duplicate) {
+        if (duplicate_policy_ == DuplicatePolicy::REJECT) {
+            throw invalid_argument("Document duplicates document "s + to_string(*duplicate));
+        }
+        if (duplicate_policy_ == DuplicatePolicy::REPLACE) {
+            RemoveDocument(*duplicate);
+        }
+    }
+    return duplicate;
+}
+
+void SearchServer::IndexFieldWords(int document_id, std::string_view field, const std::vector<std::string_view>& words) {
+    if (words.empty()) {
+        return;
+    }
+    const bool is_default_field = field == DEFAULT_FIELD;
     const double inv_word_count = 1.0 / words.size();
+    auto& word_freqs = document_to_word_freqs_[document_id];
+    string term;
+    uint32_t position = 0;
     for (const string_view word : words) {
-        const auto insert_result = words_.insert(std::string {word});
-        const std::string_view word_view {*insert_result.first};
+        string_view key = word;
+        if (!is_default_field) {
+            term.assign(field).append(1, FIELD_SEPARATOR).append(word);
+            key = term;
+        }
+        auto word_it = words_.find(key);
+        if (word_it == words_.end()) {
+            word_it = words_.insert(resources_->word_bytes.Intern(key)).first;
+            if (!is_default_field) {
+                field_term_names_.insert(string{field}.append(1, ':').append(word));
+            }
+        }
+        const std::string_view word_view {*word_it};
 
-        if (document_to_word_freqs_[document_id].count(word_view) == 0) {
-            document_to_word_freqs_[document_id][word_view] = 0;
+        word_freqs[word_view] += inv_word_count;
+
+        // Фразы и близость работают только по основному тексту
+        if (positional_index_enabled_ && is_default_field) {
+            document_to_word_positions_[document_id][word_view].Append(position++);
         }
-        document_to_word_freqs_[document_id][word_view] += inv_word_count;
+    }
+}
 
-        word_to_document_freqs_[word_view].insert(document_id);
+void SearchServer::FinishDocument(int document_id, DocumentStatus status, const std::vector<int>& ratings,
+                                  size_t word_count, uint64_t fingerprint) {
+    if (const auto it = document_to_word_freqs_.find(document_id); it != document_to_word_freqs_.end()) {
+        for (auto& [word, freq]: it->second) {
+            // Прямой индекс хранит ту же частоту, что и список документов, иначе параллельный поиск
+            // и MatchDocument разошлись бы с последовательным при QUANTIZED_16
+            freq = RoundTermFreq(freq, term_freq_encoding_);
+            auto& postings = word_to_document_freqs_[word];
+            if (postings.empty()) {
+                postings.SetEncoding(term_freq_encoding_);
+            }
+            postings.Add(document_id, freq);
+        }
     }
 
-    documents_.emplace(document_id, DocumentData{ComputeAverageRating(ratings), status});
+    documents_.emplace(document_id, DocumentData{ComputeAverageRating(ratings), status, word_count, fingerprint});
+    total_word_count_ += word_count;
     document_ids_.insert(document_id);
+    if (fingerprints_) {
+        (*fingerprints_)[fingerprint].ref_to_value = document_id;
+    }
+}
+
+void SearchServer::SetFieldWeight(std::string_view field, double weight) {
+    if (!IsValidFieldName(field)) {
+        throw invalid_argument("Invalid field name "s + string{field});
+    }
+    if (!(weight >= 0.0)) {
+        throw invalid_argument("Field weight must be non-negative"s);
+    }
+    if (const auto it = field_weights_.find(field); it != field_weights_.end()) {
+        it->second = weight;
+    } else {
+        field_weights_.emplace(field, weight);
+    }
+}
+
+bool SearchServer::IsValidFieldName(std::string_view field) {
+    return !field.empty() && field[0] != '-' && field[0] != '"' && IsValidWord(field)
+           && field.find_first_of(" :^*"sv) == string_view::npos;
+}
+
+std::optional<std::pair<std::string_view, double>> SearchServer::ParseFieldBoost(std::string_view text) const {
+    const size_t caret = text.find('^');
+    if (caret == string_view::npos) {
+        return nullopt;
+    }
+    const auto field = field_weights_.find(text.substr(0, caret));
+    if (field == field_weights_.end()) {
+        return nullopt;
+    }
+    const string_view value = text.substr(caret + 1);
+    double boost = 0.0;
+    const auto [end, error] = from_chars(value.data(), value.data() + value.size(), boost);
+    if (error != errc() || end != value.data() + value.size() || value.empty() || !(boost >= 0.0)) {
+        throw invalid_argument("Invalid field boost "s + string{text});
+    }
+    return pair{string_view{field->first}, boost};
 }
 
 std::vector<Document> SearchServer::FindTopDocuments(const std::string_view raw_query, const DocumentStatus& status) const {
@@ -52,20 +232,28 @@ SearchServer::const_iterator SearchServer::end() const {
 const std::map<const std::string_view, double> SearchServer::GetWordFrequencies(int document_id) const {
     std::map<const std::string_view, double> result;
     for (const auto& item: document_to_word_freqs_.at(document_id)) {
-        result[item.first] = item.second;
+        result[GetPublicTerm(item.first)] = item.second;
     }
     return result;
 }
 
 void SearchServer::RemoveDocument(int document_id) {
+    TRACE_STAGE(REMOVE_DOCUMENT);
+    // Прямой индекс знает слова документа, поэтому обходить весь словарь не нужно
+    if (const auto it = document_to_word_freqs_.find(document_id); it != document_to_word_freqs_.end()) {
+        for (const auto& item: it->second) {
+            word_to_document_freqs_.at(item.first).Erase(document_id);
+        }
+        document_to_word_freqs_.erase(it);
+    }
+    document_to_word_positions_.erase(document_id);
     document_ids_.erase(document_id);
-    documents_.erase(document_id);
-    document_to_word_freqs_.erase(document_id);
-
-    for (auto& item: word_to_document_freqs_) {
-        if (item.second.count(document_id)) {
-            item.second.erase(document_id);
+    if (const auto it = documents_.find(document_id); it != documents_.end()) {
+        total_word_count_ -= it->second.word_count;
+        if (fingerprints_) {
+            fingerprints_->Erase(it->second.fingerprint);
         }
+        documents_.erase(it);
     }
 }
 
@@ -76,3 +264,623 @@ void SearchServer::RemoveDocument(const std::execution::sequenced_policy &policy
 void SearchServer::RemoveDocument(const std::execution::parallel_policy &policy, int document_id) {
     RemoveDocument(document_id);
 }
+
+void SearchServer::SetMaxPrefixExpansion(size_t max_expansion) {
+    max_prefix_expansion_ = max_expansion;
+}
+
+void SearchServer::SetPositionalIndex(bool enabled) {
+    if (!documents_.empty()) {
+        throw logic_error("Positional index can be switched only for an empty server"s);
+    }
+    positional_index_enabled_ = enabled;
+}
+
+void SearchServer::SetTermFreqEncoding(TermFreqEncoding encoding) {
+    if (!documents_.empty()) {
+        throw logic_error("Term frequency encoding can be switched only for an empty server"s);
+    }
+    term_freq_encoding_ = encoding;
+}
+
+void SearchServer::SetMinimumShouldMatch(size_t count) {
+    minimum_should_match_ = count;
+}
+
+void SearchServer::SetDuplicatePolicy(DuplicatePolicy policy) {
+    if (!documents_.empty()) {
+        throw logic_error("Duplicate policy can be switched only for an empty server"s);
+    }
+    duplicate_policy_ = policy;
+    fingerprints_.reset();
+    if (policy != DuplicatePolicy::ALLOW) {
+        fingerprints_ = make_unique<ConcurrentMap<uint64_t, int>>(FINGERPRINT_BUCKET_COUNT);
+    }
+}
+
+size_t SearchServer::ParsePhrase(const std::vector<std::string_view>& words, size_t first, Query& query) const {
+    PositionalClause clause{{}, 1, true};
+    for (size_t i = first; i < words.size(); ++i) {
+        string_view word = words[i];
+        if (i == first) {
+            word.remove_prefix(1);
+        }
+        const bool is_last = !word.empty() && word.back() == '"';
+        if (is_last) {
+            word.remove_suffix(1);
+        }
+        if (!word.empty()) {
+            const auto query_word = ParseQueryWord(word);
+            if (query_word.is_minus || query_word.is_prefix || word.find('"') != string_view::npos) {
+                throw invalid_argument("Phrase word "s + string{word} + " is invalid"s);
+            }
+            if (!query_word.is_stop) {
+                clause.words.push_back(query_word.data);
+                query.plus_words.insert(query_word.data);
+            }
+        }
+        if (is_last) {
+            if (!clause.words.empty()) {
+                query.positional_clauses.push_back(move(clause));
+            }
+            return i;
+        }
+    }
+    throw invalid_argument("Phrase is not closed"s);
+}
+
+std::optional<uint32_t> SearchServer::ParseProximityOperator(std::string_view word) {
+    const string_view prefix = "NEAR/"sv;
+    if (word.substr(0, prefix.size()) != prefix) {
+        return nullopt;
+    }
+    word.remove_prefix(prefix.size());
+    if (word.empty() || word.size() > 9 || !all_of(word.begin(), word.end(), [](char c) {
+        return c >= '0' && c <= '9';
+    })) {
+        throw invalid_argument("Proximity operator NEAR/"s + string{word} + " is invalid"s);
+    }
+    const auto distance = static_cast<uint32_t>(stoul(string{word}));
+    if (distance == 0) {
+        throw invalid_argument("Proximity distance must be positive"s);
+    }
+    return distance;
+}
+
+std::optional<size_t> SearchServer::ParseMinimumMatchOperator(std::string_view word) {
+    const string_view prefix = "MATCH/"sv;
+    if (word.substr(0, prefix.size()) != prefix) {
+        return nullopt;
+    }
+    word.remove_prefix(prefix.size());
+    if (word == "ALL"sv) {
+        return MATCH_ALL_WORDS;
+    }
+    if (word.empty() || word.size() > 9 || !all_of(word.begin(), word.end(), [](char c) {
+        return c >= '0' && c <= '9';
+    })) {
+        throw invalid_argument("Match operator MATCH/"s + string{word} + " is invalid"s);
+    }
+    return static_cast<size_t>(stoul(string{word}));
+}
+
+void SearchServer::ParseProximity(std::optional<std::string_view> left, std::string_view right, uint32_t distance,
+                                  Query& query) const {
+    const auto query_word = ParseQueryWord(right);
+    if (query_word.is_minus || query_word.is_prefix || ParseProximityOperator(right)) {
+        throw invalid_argument("Proximity operand "s + string{right} + " is invalid"s);
+    }
+    if (!left) {
+        throw invalid_argument("Proximity operator has no left operand"s);
+    }
+    if (query_word.is_stop) {
+        return;
+    }
+    query.plus_words.insert(query_word.data);
+    // Пустой левый операнд означает стоп-слово: условие с ним не накладывается
+    if (left->empty()) {
+        return;
+    }
+    query.positional_clauses.push_back({{*left, query_word.data}, distance, false});
+}
+
+IndexVerificationResult SearchServer::Verify() const {
+    IndexVerificationResult result;
+    mutex m;
+    const auto report = [&result, &m](string message) {
+        lock_guard guard(m);
+        if (result.error_count++ < IndexVerificationResult::MAX_REPORTED_ERRORS) {
+            result.errors.push_back(move(message));
+        }
+    };
+    const auto is_interned = [this](string_view word) {
+        const auto it = words_.find(word);
+        return it != words_.end() && it->data() == word.data();
+    };
+
+    if (!equal(documents_.begin(), documents_.end(), document_ids_.begin(), document_ids_.end(),
+               [](const auto& document, int document_id) { return document.first == document_id; })) {
+        report("Registered documents differ from document ids"s);
+    }
+    size_t word_count = 0;
+    for (const auto& [document_id, document]: documents_) {
+        word_count += document.word_count;
+    }
+    if (word_count != total_word_count_) {
+        report("Total word count is "s + to_string(total_word_count_) + ", documents have "s + to_string(word_count));
+    }
+
+    atomic<size_t> forward_entries{0};
+    for_each(execution::par, document_to_word_freqs_.begin(), document_to_word_freqs_.end(), [&](const auto& item) {
+        const auto& [document_id, word_freqs] = item;
+        const string document = "Document "s + to_string(document_id);
+        if (documents_.count(document_id) == 0) {
+            report(document + " is indexed but not registered"s);
+        }
+        forward_entries += word_freqs.size();
+        for (const auto& [word, term_freq]: word_freqs) {
+            if (!is_interned(word)) {
+                report(document + " refers to a word outside the dictionary"s);
+            }
+            if (!(term_freq > 0.0 && term_freq <= 1.0)) {
+                report(document + " has term frequency "s + to_string(term_freq) + " for "s + string{word});
+            }
+            const auto postings = word_to_document_freqs_.find(word);
+            const size_t index = postings == word_to_document_freqs_.end() ? 0 : postings->second.Seek(document_id, 0);
+            if (postings == word_to_document_freqs_.end() || index == postings->second.size()
+                || postings->second.DocumentId(index) != document_id) {
+                report(document + " is missing from the postings of "s + string{word});
+            } else if (postings->second.TermFreq(index) != term_freq) {
+                report(document + " has different term frequencies of "s + string{word} + " in the two indexes"s);
+            }
+        }
+    });
+
+    atomic<size_t> inverse_entries{0};
+    atomic<size_t> empty_posting_lists{0};
+    for_each(execution::par, word_to_document_freqs_.begin(), word_to_document_freqs_.end(), [&](const auto& item) {
+        const auto& [word, postings] = item;
+        const string term = "Postings of "s + string{word};
+        if (!is_interned(word)) {
+            report(term + " are keyed by a word outside the dictionary"s);
+        }
+        if (postings.empty()) {
+            ++empty_posting_lists;
+            return;
+        }
+        inverse_entries += postings.size();
+        const auto& ids = postings.DocumentIds();
+        if (adjacent_find(ids.begin(), ids.end(), greater_equal<>()) != ids.end()) {
+            report(term + " are not strictly sorted"s);
+        }
+        for (const int document_id: ids) {
+            const auto word_freqs = document_to_word_freqs_.find(document_id);
+            if (word_freqs == document_to_word_freqs_.end() || word_freqs->second.count(word) == 0) {
+                report(term + " contain document "s + to_string(document_id) + " without the word"s);
+            }
+        }
+        const auto& block_max = postings.GetBlockMaxTermFreqs();
+        bool block_max_valid = block_max.size() == (postings.size() + POSTING_BLOCK_SIZE - 1) / POSTING_BLOCK_SIZE;
+        for (size_t block = 0; block_max_valid && block < block_max.size(); ++block) {
+            double expected = 0.0;
+            for (size_t i = block * POSTING_BLOCK_SIZE; i < min(postings.size(), (block + 1) * POSTING_BLOCK_SIZE); ++i) {
+                expected = max(expected, postings.TermFreq(i));
+            }
+            block_max_valid = block_max[block] == expected;
+        }
+        if (!block_max_valid || postings.GetMaxTermFreq() != *max_element(block_max.begin(), block_max.end())) {
+            report(term + " have stale block maxima"s);
+        }
+    });
+    if (forward_entries != inverse_entries) {
+        report("Forward index has "s + to_string(forward_entries) + " entries, postings have "s
+               + to_string(inverse_entries));
+    }
+
+    result.orphan_terms = count_if(execution::par, words_.begin(), words_.end(), [this](string_view word) {
+        const auto postings = word_to_document_freqs_.find(word);
+        return postings == word_to_document_freqs_.end() || postings->second.empty();
+    });
+    result.empty_posting_lists = empty_posting_lists;
+
+    for (const auto& [document_id, word_positions]: document_to_word_positions_) {
+        const auto word_freqs = document_to_word_freqs_.find(document_id);
+        for (const auto& [word, positions]: word_positions) {
+            if (word_freqs == document_to_word_freqs_.end() || word_freqs->second.count(word) == 0) {
+                report("Positions of document "s + to_string(document_id) + " refer to a word it does not contain"s);
+                break;
+            }
+        }
+    }
+    if (fingerprints_) {
+        for (const auto& [document_id, document]: documents_) {
+            if (fingerprints_->Find(document.fingerprint) != document_id) {
+                report("Fingerprint of document "s + to_string(document_id) + " is not indexed"s);
+            }
+        }
+    }
+    return result;
+}
+
+CompactionStats SearchServer::Compact() {
+    CompactionStats stats;
+    const size_t bytes_before = GetMemoryStats().total_bytes;
+
+    for (auto it = word_to_document_freqs_.begin(); it != word_to_document_freqs_.end();) {
+        if (it->second.empty()) {
+            it = word_to_document_freqs_.erase(it);
+            ++stats.removed_posting_lists;
+        } else {
+            it->second.ShrinkToFit();
+            ++it;
+        }
+    }
+    for (auto it = words_.begin(); it != words_.end();) {
+        if (word_to_document_freqs_.count(*it) == 0) {
+            if (const auto name = GetPublicTerm(*it); name != *it) {
+                field_term_names_.erase(field_term_names_.find(name));
+            }
+            it = words_.erase(it);
+            ++stats.removed_terms;
+        } else {
+            ++it;
+        }
+    }
+
+    {
+        // Пул строк только растёт, поэтому живые слова переносятся в новый пул, а старый освобождается целиком.
+        // Узлы контейнеров не пересоздаются: ключи меняются у извлечённых узлов, порядок при этом сохраняется
+        StringPool compacted(&resources_->words_upstream);
+        decltype(words_) relocated_words(words_.get_allocator());
+        while (!words_.empty()) {
+            auto node = words_.extract(words_.begin());
+            node.value() = compacted.Intern(node.value());
+            relocated_words.insert(relocated_words.end(), move(node));
+        }
+        words_.swap(relocated_words);
+
+        const auto relocate = [this, &compacted](string_view word) {
+            auto it = words_.find(word);
+            if (it == words_.end()) {
+                it = words_.insert(compacted.Intern(word)).first;
+            }
+            return *it;
+        };
+        const auto relocate_keys = [&relocate](auto& map) {
+            std::remove_reference_t<decltype(map)> relocated(map.get_allocator());
+            while (!map.empty()) {
+                auto node = map.extract(map.begin());
+                node.key() = relocate(node.key());
+                relocated.insert(relocated.end(), move(node));
+            }
+            map.swap(relocated);
+        };
+        relocate_keys(word_to_document_freqs_);
+        for (auto& [document_id, word_freqs]: document_to_word_freqs_) {
+            relocate_keys(word_freqs);
+        }
+        for (auto& [document_id, word_positions]: document_to_word_positions_) {
+            relocate_keys(word_positions);
+        }
+        resources_->word_bytes.Swap(compacted);
+    }
+
+    const size_t bytes_after = GetMemoryStats().total_bytes;
+    stats.reclaimed_bytes = bytes_before > bytes_after ? bytes_before - bytes_after : 0;
+    return stats;
+}
+
+void SearchServer::RefreshInverseDocumentFreqs() {
+    for_each(execution::par, word_to_document_freqs_.begin(), word_to_document_freqs_.end(), [this](const auto& item) {
+        if (!item.second.empty()) {
+            static_cast<void>(GetInverseDocumentFreq(item.second));
+        }
+    });
+}
+
+SearchServer::ScoringCursor SearchServer::StartScoring(const Query& query) const {
+    ScoringCursor cursor;
+    size_t candidate_count = 0;
+    if (query.minimum_match > 1) {
+        candidate_count = StartMinimumMatch(query, cursor);
+    } else {
+        for (const string_view word : query.plus_words) {
+            if (const auto it = word_to_document_freqs_.find(word); it != word_to_document_freqs_.end()) {
+                cursor.postings.AddList(it->second, GetInverseDocumentFreq(it->second) * GetQueryWordWeight(query, word));
+                candidate_count += it->second.size();
+            }
+        }
+    }
+    if (candidate_count == 0) {
+        return cursor;
+    }
+
+    TRACE_STAGE(CANDIDATES);
+    // Кандидаты для фраз считаются пересечением списков до проверки позиций
+    cursor.positional_matches = FindPositionalMatches(query);
+    if (cursor.positional_matches) {
+        if (cursor.positional_matches->empty()) {
+            cursor.postings = PostingsUnion{};
+            return cursor;
+        }
+        candidate_count = min(candidate_count, cursor.positional_matches->size());
+    }
+
+    for (const string_view word : query.minus_words) {
+        const auto it = word_to_document_freqs_.find(word);
+        if (it == word_to_document_freqs_.end() || it->second.empty()) {
+            continue;
+        }
+        if (it->second.size() <= candidate_count) {
+            const auto& ids = it->second.DocumentIds();
+            cursor.docs_with_minus_word.insert(cursor.docs_with_minus_word.end(), ids.begin(), ids.end());
+        } else {
+            cursor.minus_probes.push_back({&it->second, 0});
+        }
+    }
+    sort(cursor.docs_with_minus_word.begin(), cursor.docs_with_minus_word.end());
+    // Чем длиннее список, тем вероятнее, что кандидат в нём есть и остальные списки проверять не придётся
+    sort(cursor.minus_probes.begin(), cursor.minus_probes.end(), [](const auto& lhs, const auto& rhs) {
+        return lhs.postings->size() > rhs.postings->size();
+    });
+    return cursor;
+}
+
+size_t SearchServer::StartMinimumMatch(const Query& query, ScoringCursor& cursor) const {
+    PostingsMatcher& matcher = cursor.matcher.emplace();
+    map<string_view, size_t> term_indexes;
+    for (const string_view word : query.plus_words) {
+        const auto it = word_to_document_freqs_.find(word);
+        if (it != word_to_document_freqs_.end() && !it->second.empty()) {
+            term_indexes[word] = matcher.AddTerm(it->second, GetInverseDocumentFreq(it->second) * GetQueryWordWeight(query, word));
+        }
+    }
+    for (const auto& group: query.match_groups) {
+        vector<size_t> terms;
+        for (const string_view word: group) {
+            if (const auto it = term_indexes.find(word); it != term_indexes.end()) {
+                terms.push_back(it->second);
+            }
+        }
+        // Группа без документов не совпадёт ни с одним документом
+        if (!terms.empty()) {
+            matcher.AddGroup(terms);
+        }
+    }
+    matcher.SetMinimumMatch(query.minimum_match);
+    const auto& groups = matcher.GetGroups();
+    if (groups.size() < query.minimum_match) {
+        cursor.matcher.reset();
+        return 0;
+    }
+
+    // Документ с minimum_match группами из n обязательно есть в одной из n - minimum_match + 1 самых редких групп,
+    // поэтому кандидаты берутся только из них. Для MATCH/ALL это одна самая редкая группа
+    set<size_t> candidate_terms;
+    for (size_t i = 0; i + query.minimum_match < groups.size() + 1; ++i) {
+        candidate_terms.insert(groups[i].begin(), groups[i].end());
+    }
+    size_t candidate_count = 0;
+    for (const size_t term: candidate_terms) {
+        cursor.postings.AddList(matcher.GetPostings(term), matcher.GetWeight(term));
+        candidate_count += matcher.GetPostings(term).size();
+    }
+    return candidate_count;
+}
+
+std::optional<TermStatistics> SearchServer::GetTermStatistics(std::string_view word) const {
+    const auto it = word_to_document_freqs_.find(word);
+    if (it == word_to_document_freqs_.end() || it->second.empty()) {
+        return nullopt;
+    }
+    const PostingList& postings = it->second;
+    const auto& block_max = postings.GetBlockMaxTermFreqs();
+    return TermStatistics{postings.size(), GetInverseDocumentFreq(postings), postings.GetMaxTermFreq(),
+                          {block_max.begin(), block_max.end()}};
+}
+
+IndexStatistics SearchServer::GetIndexStatistics() const {
+    IndexStatistics stats;
+    const auto add_to_histogram = [](vector<size_t>& histogram, size_t bucket) {
+        if (histogram.size() <= bucket) {
+            histogram.resize(bucket + 1);
+        }
+        ++histogram[bucket];
+    };
+    for (const auto& [word, postings]: word_to_document_freqs_) {
+        if (postings.empty()) {
+            continue;
+        }
+        ++stats.term_count;
+        stats.postings_count += postings.size();
+        stats.max_document_freq = max(stats.max_document_freq, postings.size());
+        add_to_histogram(stats.document_freq_histogram, static_cast<size_t>(bit_width(postings.size()) - 1));
+        // Частоты лежат в (0, 1], поэтому -log2 неотрицателен
+        add_to_histogram(stats.max_term_freq_histogram, static_cast<size_t>(floor(-log2(postings.GetMaxTermFreq()))));
+    }
+    return stats;
+}
+
+std::optional<std::vector<int>> SearchServer::FindPositionalMatches(const Query& query) const {
+    if (query.positional_clauses.empty()) {
+        return nullopt;
+    }
+    vector<int> result;
+    bool first_clause = true;
+    for (const auto& clause: query.positional_clauses) {
+        // Сначала пересекаем списки документов начиная с самого короткого, позиции проверяем только у кандидатов
+        vector<const PostingList*> postings;
+        for (const string_view word: clause.words) {
+            const auto it = word_to_document_freqs_.find(word);
+            if (it == word_to_document_freqs_.end() || it->second.empty()) {
+                return vector<int>{};
+            }
+            postings.push_back(&it->second);
+        }
+        sort(postings.begin(), postings.end(), [](const PostingList* lhs, const PostingList* rhs) {
+            return lhs->size() < rhs->size();
+        });
+        const auto& shortest_ids = postings.front()->DocumentIds();
+        vector<int> candidates = first_clause ? vector<int>(shortest_ids.begin(), shortest_ids.end()) : result;
+        for (size_t i = first_clause ? 1 : 0; i < postings.size(); ++i) {
+            vector<int> intersection;
+            const auto& ids = postings[i]->DocumentIds();
+            set_intersection(candidates.begin(), candidates.end(), ids.begin(), ids.end(), back_inserter(intersection));
+            candidates = move(intersection);
+        }
+        candidates.erase(remove_if(candidates.begin(), candidates.end(), [this, &clause](int document_id) {
+            return !SatisfiesPositionalClause(clause, document_id);
+        }), candidates.end());
+        result = move(candidates);
+        first_clause = false;
+        if (result.empty()) {
+            break;
+        }
+    }
+    return result;
+}
+
+bool SearchServer::SatisfiesPositionalClauses(const Query& query, int document_id) const {
+    return all_of(query.positional_clauses.begin(), query.positional_clauses.end(), [this, document_id](const auto& clause) {
+        return SatisfiesPositionalClause(clause, document_id);
+    });
+}
+
+bool SearchServer::SatisfiesPositionalClause(const PositionalClause& clause, int document_id) const {
+    const auto document_it = document_to_word_positions_.find(document_id);
+    if (document_it == document_to_word_positions_.end()) {
+        return false;
+    }
+    vector<vector<uint32_t>> positions;
+    positions.reserve(clause.words.size());
+    for (const string_view word: clause.words) {
+        const auto it = document_it->second.find(word);
+        if (it == document_it->second.end()) {
+            return false;
+        }
+        positions.push_back(it->second.Decode());
+    }
+
+    if (clause.ordered) {
+        return any_of(positions[0].begin(), positions[0].end(), [&positions](uint32_t start) {
+            for (size_t i = 1; i < positions.size(); ++i) {
+                if (!binary_search(positions[i].begin(), positions[i].end(), start + static_cast<uint32_t>(i))) {
+                    return false;
+                }
+            }
+            return true;
+        });
+    }
+
+    // Два возрастающих списка: ищем ближайшую пару встречным проходом
+    const auto& lhs = positions[0];
+    const auto& rhs = positions[1];
+    size_t i = 0;
+    size_t j = 0;
+    while (i < lhs.size() && j < rhs.size()) {
+        const uint32_t distance = lhs[i] > rhs[j] ? lhs[i] - rhs[j] : rhs[j] - lhs[i];
+        if (distance > 0 && distance <= clause.max_distance) {
+            return true;
+        }
+        if (lhs[i] < rhs[j]) {
+            ++i;
+        } else {
+            ++j;
+        }
+    }
+    return false;
+}
+
+void SearchServer::SetFuzzyMatching(int max_edits) {
+    if (max_edits < 0 || max_edits > 2) {
+        throw invalid_argument("Fuzzy matching supports up to 2 edits"s);
+    }
+    max_fuzzy_edits_ = max_edits;
+}
+
+void SearchServer::ExpandFuzzy(std::string_view word, Query& query, std::set<std::string_view>& corrected) const {
+    // Короткие слова исправлять бессмысленно: на расстоянии 2 от них оказывается пол-словаря
+    const int max_edits = min(max_fuzzy_edits_, word.size() < 3 ? 0 : word.size() < 6 ? 1 : 2);
+    if (max_edits == 0) {
+        return;
+    }
+
+    struct Correction {
+        string_view word;
+        int distance;
+        size_t document_count;
+    };
+    vector<Correction> corrections;
+    const LevenshteinAutomaton automaton(word, max_edits);
+    ForEachFuzzyMatch(word_to_document_freqs_, automaton, MAX_FUZZY_MATCH_STEPS,
+                      [&corrections](const auto& item, int distance) {
+                          // Слова полей исправлениями слов основного текста не считаются
+                          if (!item.second.empty() && item.first.find(FIELD_SEPARATOR) == string_view::npos) {
+                              corrections.push_back({item.first, distance, item.second.size()});
+                          }
+                      });
+
+    const size_t count = min(corrections.size(), MAX_FUZZY_EXPANSION);
+    partial_sort(corrections.begin(), corrections.begin() + count, corrections.end(),
+                 [](const Correction& lhs, const Correction& rhs) {
+                     return tie(lhs.distance, rhs.document_count) < tie(rhs.distance, lhs.document_count);
+                 });
+    for (size_t i = 0; i < count; ++i) {
+        const double weight = pow(FUZZY_MATCH_PENALTY, corrections[i].distance);
+        auto& current = query.word_weights[corrections[i].word];
+        current = max(current, weight);
+        corrected.insert(corrections[i].word);
+    }
+}
+
+IndexMemoryStats SearchServer::GetMemoryStats() const {
+    IndexMemoryStats stats;
+    stats.vocabulary_size = words_.size();
+    stats.document_count = documents_.size();
+    for (const auto& [document_id, word_freqs]: document_to_word_freqs_) {
+        stats.postings_count += word_freqs.size();
+    }
+    stats.average_document_length = documents_.empty() ? 0.0 : total_word_count_ * 1.0 / documents_.size();
+
+    if constexpr (CountingResource::IsCounting()) {
+        const auto read = [](const CountingResource& resource) {
+            return StructureMemoryStats{resource.GetBytes(), resource.GetAllocationCount()};
+        };
+        stats.words = read(resources_->words_upstream);
+        stats.document_to_word_freqs = read(resources_->document_to_word_freqs_upstream);
+        stats.word_to_document_freqs = read(resources_->word_to_document_freqs_upstream);
+        stats.documents = read(resources_->documents_upstream);
+        stats.word_positions = read(resources_->word_positions_upstream);
+        stats.exact = true;
+    } else {
+        // Узел красно-чёрного дерева: три указателя и цвет перед значением
+        const size_t tree_node = 4 * sizeof(void*);
+        stats.words.bytes = words_.size() * (tree_node + sizeof(std::string_view))
+                            + resources_->word_bytes.GetReservedBytes();
+        stats.words.allocations = words_.size();
+        for (const auto& [document_id, word_freqs]: document_to_word_freqs_) {
+            stats.document_to_word_freqs.bytes += tree_node + sizeof(document_id) + sizeof(word_freqs)
+                                                  + word_freqs.size() * (tree_node + sizeof(std::string_view) + sizeof(double));
+            stats.document_to_word_freqs.allocations += 1 + word_freqs.size();
+        }
+        for (const auto& [word, postings]: word_to_document_freqs_) {
+            stats.word_to_document_freqs.bytes += tree_node + sizeof(word) + sizeof(postings)
+                                                  + postings.GetBlockMaxTermFreqs().size() * sizeof(double)
+                                                  + postings.size() * (sizeof(int) + (postings.GetEncoding() == TermFreqEncoding::EXACT
+                                                                                      ? sizeof(double) : sizeof(uint16_t)));
+            stats.word_to_document_freqs.allocations += postings.empty() ? 1 : 4;
+        }
+        stats.documents.bytes = documents_.size() * (2 * tree_node + sizeof(int) + sizeof(DocumentData) + sizeof(int));
+        stats.documents.allocations = 2 * documents_.size();
+        for (const auto& [document_id, word_positions]: document_to_word_positions_) {
+            stats.word_positions.bytes += tree_node + sizeof(document_id) + sizeof(word_positions);
+            for (const auto& [word, positions]: word_positions) {
+                stats.word_positions.bytes += tree_node + sizeof(word) + sizeof(positions) + positions.size() * 2;
+            }
+            stats.word_positions.allocations += 1 + 2 * word_positions.size();
+        }
+    }
+    stats.total_bytes = stats.words.bytes + stats.document_to_word_freqs.bytes + stats.word_to_document_freqs.bytes
+                        + stats.documents.bytes + stats.word_positions.bytes;
+    return stats;
+}
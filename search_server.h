@@ -9,34 +9,80 @@
 #include <map>
 #include <set>
 #include <execution>
+#include <memory>
+#include <memory_resource>
 #include <mutex>
+#include <limits>
+#include <optional>
 #include <type_traits>
 
 #include "read_input_functions.h"
 #include "document.h"
 #include "string_processing.h"
 #include "concurrent_map.h"
-
-#include "log_duration.h"
+#include "posting_list.h"
+#include "position_list.h"
+#include "levenshtein_automaton.h"
+
+#include "instrumentation.h"
+#include "memory_accounting.h"
+#include "string_pool.h"
+#include "stop_word_filter.h"
+#include "query_budget.h"
+#include "ranking.h"
+#include "task.h"
+#include "executor.h"
+#include "term_fingerprint.h"
+#include "index_statistics.h"
 
 using namespace std::literals::string_literals;
 
 const int MAX_RESULT_DOCUMENT_COUNT = 5;
+const size_t MAX_PREFIX_EXPANSION = 64;
+const size_t MAX_FUZZY_EXPANSION = 8;
+const size_t MAX_FUZZY_MATCH_STEPS = 20000;
+const double FUZZY_MATCH_PENALTY = 0.5;
+// Слова полей, кроме DEFAULT_FIELD, хранятся в словаре как "поле" FIELD_SEPARATOR "слово".
+// Разделитель — управляющий символ, который не может встретиться в корректном слове
+const char FIELD_SEPARATOR = '\x1F';
+const std::string_view DEFAULT_FIELD = "body";
+// Корзин в индексе отпечатков для поиска дубликатов
+const size_t FINGERPRINT_BUCKET_COUNT = 256;
+// Документ должен содержать все слова запроса (SetMinimumShouldMatch, MATCH/ALL в запросе)
+const size_t MATCH_ALL_WORDS = std::numeric_limits<size_t>::max();
+// Через сколько документов поиск с бюджетом проверяет время и число просмотренных записей
+const size_t BUDGET_CHECK_INTERVAL = 256;
+// Сколько документов асинхронный запрос обрабатывает между возвратами управления исполнителю
+const size_t ASYNC_SCORING_BLOCK = 4096;
+// Сколько найденных документов потоковая выдача держит в памяти между вызовами обработчика
+const size_t STREAM_SCORING_BLOCK = 4096;
 
 class SearchServer {
 private:
     struct DocumentData {
         int rating;
         DocumentStatus status;
+        size_t word_count;
+        // Отпечаток множества слов, если включён поиск дубликатов
+        uint64_t fingerprint;
     };
 public:
-    using const_iterator = std::set<int>::const_iterator;
+    using const_iterator = std::pmr::set<int>::const_iterator;
 
     template<typename StringContainer>
     explicit SearchServer(const StringContainer &stop_words)
             : stop_words_(MakeUniqueNonEmptyStrings(stop_words))  // Extract non-empty stop words
     {
-        if (!all_of(stop_words_.begin(), stop_words_.end(), IsValidWord)) {
+        if (!all_of(stop_words_.GetWords().begin(), stop_words_.GetWords().end(), IsValidWord)) {
+            throw std::invalid_argument("Some of stop words are invalid"s);
+        }
+    }
+
+    // Стоп-слова, таблица которых построена при компиляции
+    template<size_t N>
+    explicit SearchServer(const StaticStopWords<N> &stop_words)
+            : stop_words_(stop_words.ToFilter()) {
+        if (!all_of(stop_words_.GetWords().begin(), stop_words_.GetWords().end(), IsValidWord)) {
             throw std::invalid_argument("Some of stop words are invalid"s);
         }
     }
@@ -51,31 +97,53 @@ public:
     {
     }
 
+    // Индекс хранит string_view на собственные строки и память своих ресурсов, поэтому копировать его нельзя
+    SearchServer(const SearchServer &) = delete;
+
+    SearchServer &operator=(const SearchServer &) = delete;
+
+    SearchServer(SearchServer &&) = default;
+
+    SearchServer &operator=(SearchServer &&) = delete;
+
     void
     AddDocument(int document_id, std::string_view document, DocumentStatus status,
                 const std::vector<int> &ratings);
 
+    // Документ из нескольких полей. У каждого поля свои списки документов и своя нормировка частот на длину поля;
+    // поле DEFAULT_FIELD индексируется так же, как текст в AddDocument. Имя поля — непустое слово
+    // без пробелов и символов ':' и '^'; новые поля получают вес 1
+    void AddDocument(int document_id, const std::vector<DocumentField> &fields, DocumentStatus status,
+                     const std::vector<int> &ratings);
+
+    // Слова документа без стоп-слов. Метод константный, его можно вызывать из нескольких потоков,
+    // чтобы разбивать тексты параллельно с индексацией
+    [[nodiscard]] std::vector<std::string_view> Tokenize(std::string_view document) const {
+        return SplitIntoWordsNoStop(document);
+    }
+
+    // Добавление документа, разбитого через Tokenize. Слова копируются в словарь, исходный текст может быть освобождён.
+    // Слова проверяются так же, как при AddDocument: пустое слово или слово со служебными символами
+    // (в том числе FIELD_SEPARATOR) — invalid_argument, стоп-слова отбрасываются.
+    // fingerprint — ComputeTermSetFingerprint(words), если он уже посчитан, например в потоке разбора;
+    // если стоп-слова пришлось отбросить, отпечаток считается заново.
+    // Возвращает id найденного дубликата (см. SetDuplicatePolicy) или nullopt
+    std::optional<int> AddTokenizedDocument(int document_id, const std::vector<std::string_view> &words,
+                                            DocumentStatus status, const std::vector<int> &ratings,
+                                            std::optional<uint64_t> fingerprint = std::nullopt);
+
     template<typename ExecutionPolicy, typename DocumentPredicate>
     std::vector<Document>
     FindTopDocuments(ExecutionPolicy &&policy, const std::string_view raw_query,
                      const DocumentPredicate &document_predicate) const {
-        const auto query = ParseQuery(raw_query);
-
-        auto matched_documents = FindAllDocuments(std::execution::seq, query, document_predicate);
-
-        std::sort(matched_documents.begin(), matched_documents.end(), [](const Document &lhs, const Document &rhs) {
-            const double EPSILON = 1e-6;
-            if (std::abs(lhs.relevance - rhs.relevance) < EPSILON) {
-                return lhs.rating > rhs.rating;
-            } else {
-                return lhs.relevance > rhs.relevance;
-            }
-        });
-
-        if (matched_documents.size() > MAX_RESULT_DOCUMENT_COUNT) {
-            matched_documents.resize(MAX_RESULT_DOCUMENT_COUNT);
-        }
-
+        TRACE_QUERY_BEGIN();
+        const auto query = [this, raw_query] {
+            TRACE_STAGE(PARSE);
+            return ParseQuery(raw_query);
+        }();
+
+        auto matched_documents = FindAllDocuments(policy, query, document_predicate);
+        SelectTopDocuments(matched_documents, policy);
         return matched_documents;
     }
 
@@ -105,6 +173,134 @@ public:
 
     [[nodiscard]] std::vector<Document> FindTopDocuments(std::string_view raw_query) const;
 
+    // Поиск с ограничением времени и числа просмотренных записей списков. Бюджет проверяется в цикле подсчёта
+    // релевантности через каждые BUDGET_CHECK_INTERVAL документов. Если он исчерпан, возвращаются лучшие
+    // из уже просмотренных документов (объединение идёт по возрастанию id) с флагом partial
+    template<typename DocumentPredicate>
+    TopDocumentsResult
+    FindTopDocumentsWithinBudget(const QueryBudget &budget, const std::string_view raw_query,
+                                 const DocumentPredicate &document_predicate) const {
+        TRACE_QUERY_BEGIN();
+        const auto deadline = budget.GetDeadline(QueryBudget::Clock::now());
+        const auto query = [this, raw_query] {
+            TRACE_STAGE(PARSE);
+            return ParseQuery(raw_query);
+        }();
+
+        ScoringCursor cursor = StartScoring(query);
+        TopDocumentsResult result;
+        {
+            TRACE_STAGE(SCORING);
+            while (!cursor.postings.Exhausted()) {
+                const size_t scanned = cursor.postings.GetScannedCount();
+                if (scanned >= budget.max_postings || QueryBudget::Clock::now() >= deadline) {
+                    result.partial = true;
+                    break;
+                }
+                // Документ занимает хотя бы одну запись, поэтому блок не перескакивает лимит записей далеко
+                const size_t block = std::min(BUDGET_CHECK_INTERVAL, budget.max_postings - scanned);
+                if (ContinueScoring(cursor, document_predicate, block, result.documents)) {
+                    break;
+                }
+            }
+        }
+        result.scanned_postings = cursor.postings.GetScannedCount();
+        SelectTopDocuments(result.documents);
+        return result;
+    }
+
+    TopDocumentsResult
+    FindTopDocumentsWithinBudget(const QueryBudget &budget, const std::string_view raw_query,
+                                 DocumentStatus status) const {
+        return FindTopDocumentsWithinBudget(budget, raw_query, [status](int, DocumentStatus document_status, int) {
+            return document_status == status;
+        });
+    }
+
+    TopDocumentsResult FindTopDocumentsWithinBudget(const QueryBudget &budget, const std::string_view raw_query) const {
+        return FindTopDocumentsWithinBudget(budget, raw_query, DocumentStatus::ACTUAL);
+    }
+
+    // Асинхронный поиск для кода на корутинах. Выполняется на executor и после каждых ASYNC_SCORING_BLOCK
+    // документов объединения списков уступает потоки исполнителя, так что короткие запросы не ждут
+    // длинные. Запрос и предикат копируются в кадр корутины; сервер не должен меняться до её завершения
+    template<typename DocumentPredicate>
+    Task<std::vector<Document>>
+    FindTopDocumentsAsync(Executor &executor, std::string raw_query, DocumentPredicate document_predicate) const {
+        co_await Schedule(executor);
+        const auto query = [this, &raw_query] {
+            TRACE_STAGE(PARSE);
+            return ParseQuery(raw_query);
+        }();
+
+        ScoringCursor cursor = StartScoring(query);
+        std::vector<Document> matched_documents;
+        while (true) {
+            {
+                TRACE_STAGE(SCORING);
+                if (ContinueScoring(cursor, document_predicate, ASYNC_SCORING_BLOCK, matched_documents)) {
+                    break;
+                }
+            }
+            co_await Schedule(executor);
+        }
+        SelectTopDocuments(matched_documents);
+        co_return matched_documents;
+    }
+
+    Task<std::vector<Document>>
+    FindTopDocumentsAsync(Executor &executor, std::string raw_query, DocumentStatus status) const {
+        return FindTopDocumentsAsync(executor, std::move(raw_query), [status](int, DocumentStatus document_status, int) {
+            return document_status == status;
+        });
+    }
+
+    Task<std::vector<Document>> FindTopDocumentsAsync(Executor &executor, std::string raw_query) const {
+        return FindTopDocumentsAsync(executor, std::move(raw_query), DocumentStatus::ACTUAL);
+    }
+
+    // Все найденные документы без отбора лучших, для выгрузки больших выдач. Документы передаются в callback
+    // по мере подсчёта в порядке возрастания id, в памяти одновременно не больше STREAM_SCORING_BLOCK результатов,
+    // и ничего не сортируется: если выгрузке нужен порядок, она упорядочивает только то, что ей нужно.
+    // Возвращает число переданных документов
+    template<typename DocumentPredicate, typename Callback>
+    size_t ForEachMatchedDocument(const std::string_view raw_query, const DocumentPredicate &document_predicate,
+                                  Callback &&callback) const {
+        TRACE_QUERY_BEGIN();
+        const auto query = [this, raw_query] {
+            TRACE_STAGE(PARSE);
+            return ParseQuery(raw_query);
+        }();
+
+        ScoringCursor cursor = StartScoring(query);
+        std::vector<Document> block;
+        size_t matched_count = 0;
+        for (bool exhausted = false; !exhausted;) {
+            block.clear();
+            {
+                TRACE_STAGE(SCORING);
+                exhausted = ContinueScoring(cursor, document_predicate, STREAM_SCORING_BLOCK, block);
+            }
+            for (const Document &document: block) {
+                callback(document);
+            }
+            matched_count += block.size();
+        }
+        return matched_count;
+    }
+
+    template<typename Callback>
+    size_t ForEachMatchedDocument(const std::string_view raw_query, DocumentStatus status, Callback &&callback) const {
+        return ForEachMatchedDocument(raw_query, [status](int, DocumentStatus document_status, int) {
+            return document_status == status;
+        }, callback);
+    }
+
+    template<typename Callback>
+    size_t ForEachMatchedDocument(const std::string_view raw_query, Callback &&callback) const {
+        return ForEachMatchedDocument(raw_query, DocumentStatus::ACTUAL, callback);
+    }
+
     [[nodiscard]] int GetDocumentCount() const;
 
     [[nodiscard]] std::tuple<std::vector<std::string_view>, DocumentStatus>
@@ -113,6 +309,7 @@ public:
     template<typename ExecutionPolicy>
     std::tuple<std::vector<std::string_view>, DocumentStatus>
     MatchDocument(ExecutionPolicy &&policy, const std::string_view raw_query, int document_id) const {
+        TRACE_STAGE(MATCH_DOCUMENT);
         const auto query = ParseQuery(raw_query);
 
         std::vector<std::string_view> matched_words;
@@ -122,7 +319,9 @@ public:
                                                 return document_to_word_freqs_.count(document_id) &&
                                                        document_to_word_freqs_.at(document_id).count(word);
                                             });
-        if (!hase_minus_words) {
+        if (!hase_minus_words && SatisfiesPositionalClauses(query, document_id)
+            && (document_to_word_freqs_.count(document_id) == 0
+                || HasMinimumMatch(query, document_to_word_freqs_.at(document_id)))) {
             std::for_each(policy, query.plus_words.cbegin(), query.plus_words.cend(), [&](const auto &word) {
                 if (document_to_word_freqs_.count(document_id)) {
                     if (document_to_word_freqs_.at(document_id).count(word)) {
@@ -132,6 +331,9 @@ public:
             });
         }
 
+        for (auto &word: matched_words) {
+            word = GetPublicTerm(word);
+        }
         return {matched_words, documents_.at(document_id).status};
     }
 
@@ -147,18 +349,119 @@ public:
 
     void RemoveDocument(const std::execution::parallel_policy &policy, int document_id);
 
+    // Сколько слов словаря может подставить один префиксный терм запроса ("cat*")
+    void SetMaxPrefixExpansion(size_t max_expansion);
+
+    // Плюс-слова, которых нет в словаре, заменяются словами на расстоянии Левенштейна до max_edits (0..2).
+    // Вклад исправленного слова умножается на FUZZY_MATCH_PENALTY за каждую правку
+    void SetFuzzyMatching(int max_edits);
+
+    // Память, занятая структурами индекса. Точные байты — при сборке с SEARCH_SERVER_MEMORY_ACCOUNTING,
+    // иначе оценка по числу узлов
+    [[nodiscard]] IndexMemoryStats GetMemoryStats() const;
+
+    // Множитель вклада слов поля в релевантность. Слово запроса без указания поля ищется во всех полях
+    // с их весами, "title:cat" — только в заголовке, а слово запроса "title^3" задаёт вес поля для этого запроса.
+    // Слова поля с весом 0 ("title^0") не ищутся вовсе: документ не находится только по ним
+    void SetFieldWeight(std::string_view field, double weight);
+
+    // Статистика слова словаря (слова полей — в виде "поле" FIELD_SEPARATOR "слово"); nullopt, если у слова нет документов
+    [[nodiscard]] std::optional<TermStatistics> GetTermStatistics(std::string_view word) const;
+
+    [[nodiscard]] IndexStatistics GetIndexStatistics() const;
+
+    // Проверяет согласованность структур индекса: документы зарегистрированы, прямой и обратный индексы
+    // содержат одни и те же пары (документ, слово) с одинаковыми частотами, списки отсортированы, их блочные
+    // максимумы верны, слова лежат в словаре, позиции и отпечатки относятся к живым документам.
+    // Документы и списки проверяются параллельно; метод константный и может работать вместе с запросами
+    [[nodiscard]] IndexVerificationResult Verify() const;
+
+    // Удаляет опустевшие после RemoveDocument списки документов и слова, которых больше нет ни в одном документе,
+    // переносит живые слова в новый пул строк и отдаёт запас ёмкости списков. Нужен долго работающим процессам
+    // с постоянной сменой документов: без него словарь и пул строк только растут. Запросы на время сжатия
+    // должны быть остановлены
+    CompactionStats Compact();
+
+    // Заполняет кэш IDF всех слов для текущего числа документов. Без вызова значения пересчитываются
+    // лениво при первом запросе к слову; после массовой загрузки удобнее обновить всё сразу
+    void RefreshInverseDocumentFreqs();
+
+    // Хранить позиции слов для фразовых запросов ("white cat") и запросов близости (cat NEAR/3 tail).
+    // Включается до добавления первого документа
+    void SetPositionalIndex(bool enabled);
+
+    // Представление частот слов в списках документов (см. TermFreqEncoding). QUANTIZED_16 вдвое уменьшает
+    // списки ценой ошибки релевантности порядка 1e-5. Прямой индекс хранит те же округлённые частоты, поэтому
+    // последовательный и параллельный поиск дают одинаковые релевантности, а GetWordFrequencies — округлённые
+    // значения. Включается до добавления первого документа
+    void SetTermFreqEncoding(TermFreqEncoding encoding);
+
+    // Поиск дубликатов при добавлении: отпечаток множества слов нового документа ищется в хеш-индексе
+    // отпечатков добавленных документов, так что проверка стоит одного поиска по хешу вместо
+    // попарного сравнения в RemoveDuplicates. Включается до добавления первого документа
+    void SetDuplicatePolicy(DuplicatePolicy policy);
+
+    // Сколько слов запроса должно быть в документе, если запрос не задаёт это сам через MATCH/k или MATCH/ALL.
+    // 1 — любое слово (по умолчанию), MATCH_ALL_WORDS — все. Словом считается слово запроса вместе
+    // с подстановками префикса, исправлениями и словами полей. Кандидаты берутся из самых редких слов
+    // и проверяются по остальным спискам галопом, поэтому такой запрос стоит не больше объединения
+    void SetMinimumShouldMatch(size_t count);
+
+    [[nodiscard]] DuplicatePolicy GetDuplicatePolicy() const {
+        return duplicate_policy_;
+    }
 
 private:
-    const std::set<std::string, std::less<>> stop_words_;
-    std::set<std::string, std::less<>> words_;
-    std::map<int, std::map<std::string_view, double, std::less<>>> document_to_word_freqs_;
-    std::map<std::string_view, std::set<int>> word_to_document_freqs_;
-    std::map<int, DocumentData> documents_;
-    std::set<int> document_ids_;
+    // У каждой структуры свой пул узлов: вставки и удаления не ходят в глобальный аллокатор,
+    // освобождённые узлы переиспользуются, и при долгой смене документов память не фрагментируется.
+    // Счётчики стоят под пулами и видят память, реально взятую у системы.
+    // Ресурсы лежат в куче, чтобы пережить перемещение сервера
+    struct IndexResources {
+        CountingResource words_upstream;
+        CountingResource document_to_word_freqs_upstream;
+        CountingResource word_to_document_freqs_upstream;
+        CountingResource documents_upstream;
+        CountingResource word_positions_upstream;
+
+        std::pmr::unsynchronized_pool_resource words{&words_upstream};
+        std::pmr::unsynchronized_pool_resource document_to_word_freqs{&document_to_word_freqs_upstream};
+        std::pmr::unsynchronized_pool_resource word_to_document_freqs{&word_to_document_freqs_upstream};
+        std::pmr::unsynchronized_pool_resource documents{&documents_upstream};
+        std::pmr::unsynchronized_pool_resource word_positions{&word_positions_upstream};
+
+        // Байты слов словаря лежат подряд, words_ хранит только string_view на них
+        StringPool word_bytes{&words_upstream};
+    };
+
+    const StopWordFilter stop_words_;
+    std::unique_ptr<IndexResources> resources_ = std::make_unique<IndexResources>();
+    std::pmr::set<std::string_view, std::less<>> words_{&resources_->words};
+    std::pmr::map<int, std::pmr::map<std::string_view, double, std::less<>>> document_to_word_freqs_{
+            &resources_->document_to_word_freqs};
+    std::pmr::map<std::string_view, PostingList, std::less<>> word_to_document_freqs_{
+            &resources_->word_to_document_freqs};
+    std::pmr::map<int, DocumentData> documents_{&resources_->documents};
+    std::pmr::set<int> document_ids_{&resources_->documents};
+    std::pmr::map<int, std::pmr::map<std::string_view, PositionList, std::less<>>> document_to_word_positions_{
+            &resources_->word_positions};
+    size_t total_word_count_ = 0;
+    size_t max_prefix_expansion_ = MAX_PREFIX_EXPANSION;
+    int max_fuzzy_edits_ = 0;
+    bool positional_index_enabled_ = false;
+    size_t minimum_should_match_ = 1;
+    TermFreqEncoding term_freq_encoding_ = TermFreqEncoding::EXACT;
+    // Все известные поля с их весами
+    std::map<std::string, double, std::less<>> field_weights_{{std::string(DEFAULT_FIELD), 1.0}};
+    // Внешний вид слов полей, "поле:слово", для MatchDocument и GetWordFrequencies. Строки лежат в узлах
+    // множества и не перемещаются, поэтому на них можно возвращать string_view
+    std::set<std::string, std::less<>> field_term_names_;
+    DuplicatePolicy duplicate_policy_ = DuplicatePolicy::ALLOW;
+    // Отпечаток -> id документа; создаётся, только если дубликаты ищутся
+    std::unique_ptr<ConcurrentMap<uint64_t, int>> fingerprints_;
 
 
     [[nodiscard]] bool IsStopWord(const std::string_view &word) const {
-        return stop_words_.count(word) > 0;
+        return stop_words_.Contains(word);
     }
 
     static bool IsValidWord(const std::string_view &word) {
@@ -181,6 +484,18 @@ private:
         return words;
     }
 
+    // Оставляет MAX_RESULT_DOCUMENT_COUNT лучших документов: по релевантности, при равенстве по рейтингу
+    // (см. MakeRankKey)
+    template<typename ExecutionPolicy = std::execution::sequenced_policy>
+    static void SelectTopDocuments(std::vector<Document> &matched_documents, ExecutionPolicy && = {}) {
+        TRACE_STAGE(TOP_K);
+        if constexpr(std::is_same_v<std::decay_t<ExecutionPolicy>, std::execution::parallel_policy>) {
+            RankTopDocuments(std::execution::par, matched_documents, MAX_RESULT_DOCUMENT_COUNT);
+        } else {
+            RankTopDocuments(matched_documents, MAX_RESULT_DOCUMENT_COUNT);
+        }
+    }
+
     static int ComputeAverageRating(const std::vector<int> &ratings) {
         if (ratings.empty()) {
             return 0;
@@ -193,8 +508,32 @@ private:
         std::string_view data;
         bool is_minus;
         bool is_stop;
+        bool is_prefix;
+        // Пусто, если поле не указано
+        std::string_view field;
     };
 
+    static bool IsValidFieldName(std::string_view field);
+
+    // Слово запроса "поле^вес" для известного поля
+    [[nodiscard]] std::optional<std::pair<std::string_view, double>> ParseFieldBoost(std::string_view text) const;
+
+    // Добавляет слова одного поля в прямой индекс документа, частоты нормируются на длину поля
+    void IndexFieldWords(int document_id, std::string_view field, const std::vector<std::string_view> &words);
+
+    // Строит списки документов по прямому индексу и регистрирует документ
+    // AddTokenizedDocument без проверки слов, для уже разобранного SplitIntoWordsNoStop текста
+    std::optional<int> IndexTokenizedDocument(int document_id, const std::vector<std::string_view> &words,
+                                              DocumentStatus status, const std::vector<int> &ratings,
+                                              std::optional<uint64_t> fingerprint);
+
+    void FinishDocument(int document_id, DocumentStatus status, const std::vector<int> &ratings, size_t word_count,
+                        uint64_t fingerprint);
+
+    // Ищет документ с тем же отпечатком и применяет к нему политику: при REJECT бросает исключение,
+    // при REPLACE удаляет найденный документ. Возвращает id найденного документа
+    std::optional<int> ResolveDuplicate(uint64_t fingerprint);
+
     [[nodiscard]] QueryWord ParseQueryWord(const std::string_view &text) const {
         if (text.empty()) {
             throw std::invalid_argument("Query word is empty"s);
@@ -205,72 +544,346 @@ private:
             is_minus = true;
             word = word.substr(1);
         }
+        bool is_prefix = false;
+        if (!word.empty() && word.back() == '*') {
+            is_prefix = true;
+            word.remove_suffix(1);
+        }
+        std::string_view field;
+        if (const size_t colon = word.find(':'); colon != std::string_view::npos
+                                                 && field_weights_.count(word.substr(0, colon))) {
+            field = word.substr(0, colon);
+            word.remove_prefix(colon + 1);
+        }
         if (word.empty() || word[0] == '-' || !IsValidWord(word)) {
             throw std::invalid_argument("Query word "s + std::string{text} + " is invalid");
         }
 
-        return {word, is_minus, IsStopWord(word)};
+        return {word, is_minus, !is_prefix && IsStopWord(word), is_prefix, field};
     }
 
+    // Фраза: слова стоят подряд в указанном порядке. NEAR/k: два слова на расстоянии не больше k в любом порядке
+    struct PositionalClause {
+        std::vector<std::string_view> words;
+        uint32_t max_distance;
+        bool ordered;
+    };
+
     struct Query {
         std::set<std::string_view> plus_words;
         std::set<std::string_view> minus_words;
+        std::vector<PositionalClause> positional_clauses;
+        // Множители вклада для слов, подставленных нечётким поиском; у остальных слов множитель 1
+        std::map<std::string_view, double> word_weights;
+        // Веса полей, заданные в запросе ("title^3")
+        std::map<std::string_view, double> field_boosts;
+        // Слова документов, подходящие под каждое слово запроса: само слово, подстановки префикса,
+        // исправления и слова полей. Слова фраз и правые операнды NEAR в группы не входят
+        std::vector<std::set<std::string_view>> match_groups;
+        // Сколько групп должно найтись в документе; при 1 подходит любое плюс-слово
+        size_t minimum_match = 1;
     };
 
     [[nodiscard]] Query ParseQuery(const std::string_view text) const {
         Query result;
         const auto words = SplitIntoWords(text);
-        std::for_each(words.cbegin(), words.cend(), [&](const auto &word) {
-            const auto query_word = ParseQueryWord(word);
-            if (!query_word.is_stop) {
-                if (query_word.is_minus) {
-                    result.minus_words.insert(query_word.data);
+        std::optional<std::string_view> last_plain_word;
+        bool has_minimum_match = false;
+        for (size_t i = 0; i < words.size(); ++i) {
+            if (words[i].front() == '"') {
+                i = ParsePhrase(words, i, result);
+                last_plain_word.reset();
+                continue;
+            }
+            if (const auto distance = ParseProximityOperator(words[i])) {
+                if (i + 1 == words.size()) {
+                    throw std::invalid_argument("Proximity operator "s + std::string{words[i]} + " has no right operand"s);
+                }
+                ParseProximity(last_plain_word, words[++i], *distance, result);
+                last_plain_word.reset();
+                continue;
+            }
+            if (const auto minimum_match = ParseMinimumMatchOperator(words[i])) {
+                result.minimum_match = *minimum_match;
+                has_minimum_match = true;
+                last_plain_word.reset();
+                continue;
+            }
+            if (const auto boost = ParseFieldBoost(words[i])) {
+                result.field_boosts[boost->first] = boost->second;
+                last_plain_word.reset();
+                continue;
+            }
+            const auto query_word = ParseQueryWord(words[i]);
+            if (query_word.is_stop) {
+                last_plain_word = std::string_view{};
+                continue;
+            }
+            std::set<std::string_view> terms;
+            std::set<std::string_view> corrections;
+            auto &destination = query_word.is_minus ? result.minus_words : terms;
+            if (query_word.field.empty() || query_word.field == DEFAULT_FIELD) {
+                if (query_word.is_prefix) {
+                    ExpandPrefix(query_word.data, destination);
+                } else if (!query_word.is_minus && max_fuzzy_edits_ > 0 && !HasPostings(query_word.data)) {
+                    ExpandFuzzy(query_word.data, result, corrections);
                 } else {
-                    result.plus_words.insert(query_word.data);
+                    destination.insert(query_word.data);
+                }
+            }
+            if (query_word.field.empty()) {
+                for (const auto &[field, weight]: field_weights_) {
+                    if (field != DEFAULT_FIELD) {
+                        AddFieldTerms(field, query_word, destination);
+                    }
+                }
+            } else if (query_word.field != DEFAULT_FIELD) {
+                AddFieldTerms(query_word.field, query_word, destination);
+            }
+            if (!query_word.is_minus) {
+                result.plus_words.insert(terms.begin(), terms.end());
+                // Исправления попадают в плюс-слова после разбора, вместе со своими множителями
+                terms.merge(corrections);
+                // Повтор слова в запросе не считается вторым совпадением
+                if (std::find(result.match_groups.begin(), result.match_groups.end(), terms) == result.match_groups.end()) {
+                    result.match_groups.push_back(std::move(terms));
                 }
             }
+            if (!query_word.field.empty() && query_word.field != DEFAULT_FIELD) {
+                last_plain_word.reset();
+                continue;
+            }
+            if (!query_word.is_minus && !query_word.is_prefix) {
+                last_plain_word = query_word.data;
+            } else {
+                last_plain_word.reset();
+            }
+        }
+        if (!result.positional_clauses.empty() && !positional_index_enabled_) {
+            throw std::invalid_argument("Phrase and proximity queries require the positional index"s);
+        }
+        // Исправления попадают в плюс-слова после разбора; слово, которое есть в запросе точно, не штрафуется
+        for (auto it = result.word_weights.begin(); it != result.word_weights.end();) {
+            if (result.plus_words.insert(it->first).second) {
+                ++it;
+            } else {
+                it = result.word_weights.erase(it);
+            }
+        }
+        // Вес поля может прийти после слова ("cat title^0"), поэтому слова с нулевым весом убираются в конце:
+        // иначе документ, где нашлись только они, попал бы в выдачу с нулевой релевантностью
+        std::erase_if(result.plus_words, [this, &result](const std::string_view word) {
+            return GetQueryWordWeight(result, word) == 0.0;
+        });
+        for (auto &group: result.match_groups) {
+            std::erase_if(group, [&result](const std::string_view word) {
+                return result.plus_words.count(word) == 0;
+            });
+        }
+        std::erase_if(result.match_groups, [](const std::set<std::string_view> &group) {
+            return group.empty();
         });
+        if (!has_minimum_match) {
+            result.minimum_match = minimum_should_match_;
+        }
+        if (result.minimum_match == MATCH_ALL_WORDS) {
+            result.minimum_match = result.match_groups.size();
+        }
         return result;
     }
 
-    // Existence required
-    [[nodiscard]] double ComputeWordInverseDocumentFreq(const std::string_view &word) const {
-        size_t doc_count = 0;
-        if (word_to_document_freqs_.count(word)) {
-            doc_count = word_to_document_freqs_.at(word).size();
+    // Возвращает индекс слова, закрывающего фразу
+    size_t ParsePhrase(const std::vector<std::string_view> &words, size_t first, Query &query) const;
+
+    // Для слова вида NEAR/k возвращает k
+    static std::optional<uint32_t> ParseProximityOperator(std::string_view word);
+
+    // MATCH/k — документ должен содержать хотя бы k слов запроса, MATCH/ALL — все слова
+    static std::optional<size_t> ParseMinimumMatchOperator(std::string_view word);
+
+    void ParseProximity(std::optional<std::string_view> left, std::string_view right, uint32_t distance,
+                        Query &query) const;
+
+    // Словарь упорядочен, поэтому слова с общим префиксом лежат подряд начиная с lower_bound.
+    // Префикс основного текста не раскрывается в слова полей: FIELD_SEPARATOR меньше любого допустимого символа,
+    // поэтому все слова поля "title" лежат подряд между "title" FIELD_SEPARATOR и "title" FIELD_SEPARATOR + 1
+    // и пропускаются одним поиском
+    void ExpandPrefix(const std::string_view prefix, std::set<std::string_view> &destination) const {
+        const bool is_field_prefix = prefix.find(FIELD_SEPARATOR) != std::string_view::npos;
+        size_t expanded = 0;
+        for (auto it = word_to_document_freqs_.lower_bound(prefix);
+             it != word_to_document_freqs_.end() && expanded < max_prefix_expansion_;) {
+            if (it->first.substr(0, prefix.size()) != prefix) {
+                break;
+            }
+            if (const size_t separator = it->first.find(FIELD_SEPARATOR);
+                    !is_field_prefix && separator != std::string_view::npos) {
+                std::string field_end{it->first.substr(0, separator)};
+                field_end.push_back(static_cast<char>(FIELD_SEPARATOR + 1));
+                it = word_to_document_freqs_.lower_bound(field_end);
+                continue;
+            }
+            if (!it->second.empty()) {
+                destination.insert(it->first);
+                ++expanded;
+            }
+            ++it;
+        }
+    }
+
+    // Слово словаря в том виде, в каком его видит пользователь: "title" FIELD_SEPARATOR "cat" -> "title:cat"
+    [[nodiscard]] std::string_view GetPublicTerm(std::string_view term) const {
+        const size_t separator = term.find(FIELD_SEPARATOR);
+        if (separator == std::string_view::npos) {
+            return term;
         }
-        return std::log(GetDocumentCount() * 1.0 / doc_count);
+        std::string name{term};
+        name[separator] = ':';
+        const auto it = field_term_names_.find(name);
+        return it == field_term_names_.end() ? term : std::string_view{*it};
     }
 
-    template<typename DocumentPredicate>
-    std::vector<Document>
-    FindAllDocumentsSequenced(const Query &query, const DocumentPredicate &document_predicate) const {
+    // Слово запроса в поле field: точное слово поля или все слова поля с этим префиксом
+    void AddFieldTerms(std::string_view field, const QueryWord &query_word,
+                       std::set<std::string_view> &destination) const {
+        std::string term;
+        term.reserve(field.size() + 1 + query_word.data.size());
+        term.append(field).append(1, FIELD_SEPARATOR).append(query_word.data);
+        if (query_word.is_prefix) {
+            ExpandPrefix(term, destination);
+        } else if (const auto it = word_to_document_freqs_.find(term);
+                   it != word_to_document_freqs_.end() && !it->second.empty()) {
+            destination.insert(it->first);
+        }
+    }
 
-        std::map<int, double> document_to_relevance;
-
-        for (const std::string_view word : query.plus_words) {
-            const double inverse_document_freq = ComputeWordInverseDocumentFreq(word);
-            for (const auto &item : document_to_word_freqs_) {
-                const auto document_id = item.first;
-                const auto &word_freqs = item.second;
-                if (std::any_of(query.minus_words.cbegin(), query.minus_words.cend(),
-                                [&word_freqs](const auto &word) { return word_freqs.count(word); })
-                    || word_freqs.count(word) == 0) {
-                    continue;
-                }
-                const auto &document_data = documents_.at(document_id);
-                if (document_predicate(document_id, document_data.status, document_data.rating)) {
-                    document_to_relevance[document_id] += word_freqs.at(word) * inverse_document_freq;
-                }
+    // Документы, удовлетворяющие всем фразам и условиям близости запроса; nullopt, если таких условий нет
+    [[nodiscard]] std::optional<std::vector<int>> FindPositionalMatches(const Query &query) const;
+
+    [[nodiscard]] bool SatisfiesPositionalClauses(const Query &query, int document_id) const;
+
+    [[nodiscard]] bool SatisfiesPositionalClause(const PositionalClause &clause, int document_id) const;
+
+    template<typename WordFreqs>
+    [[nodiscard]] static bool HasMinimumMatch(const Query &query, const WordFreqs &word_freqs) {
+        if (query.minimum_match <= 1) {
+            return true;
+        }
+        const size_t matched = std::count_if(query.match_groups.begin(), query.match_groups.end(),
+                                             [&word_freqs](const auto &group) {
+                                                 return std::any_of(group.begin(), group.end(), [&word_freqs](const auto &word) {
+                                                     return word_freqs.count(word) > 0;
+                                                 });
+                                             });
+        return matched >= query.minimum_match;
+    }
+
+    [[nodiscard]] bool HasPostings(const std::string_view word) const {
+        const auto it = word_to_document_freqs_.find(word);
+        return it != word_to_document_freqs_.end() && !it->second.empty();
+    }
+
+    // Исправления слова записываются в query.word_weights и в corrections
+    void ExpandFuzzy(std::string_view word, Query &query, std::set<std::string_view> &corrections) const;
+
+    // Множитель нечёткого поиска, умноженный на вес поля слова
+    [[nodiscard]] double GetQueryWordWeight(const Query &query, const std::string_view word) const {
+        const auto it = query.word_weights.find(word);
+        const double weight = it == query.word_weights.end() ? 1.0 : it->second;
+        const size_t separator = word.find(FIELD_SEPARATOR);
+        const std::string_view field = separator == std::string_view::npos ? DEFAULT_FIELD : word.substr(0, separator);
+        if (const auto boost = query.field_boosts.find(field); boost != query.field_boosts.end()) {
+            return weight * boost->second;
+        }
+        const auto field_weight = field_weights_.find(field);
+        return field_weight == field_weights_.end() ? weight : weight * field_weight->second;
+    }
+
+    // IDF хранится в самом списке документов и пересчитывается, только когда изменилось число документов
+    [[nodiscard]] double GetInverseDocumentFreq(const PostingList &postings) const {
+        return postings.GetInverseDocumentFreq(document_ids_.size());
+    }
+
+    struct MinusWordProbe {
+        const PostingList *postings;
+        size_t position;
+    };
+
+    // Последовательный подсчёт релевантности, который можно прерывать и продолжать
+    struct ScoringCursor {
+        // Документы с редкими минус-словами: отсортированный список id, по которому идём синхронно с объединением
+        std::vector<int> docs_with_minus_word;
+        size_t minus_position = 0;
+        // Частые минус-слова не выписываются целиком: кандидат ищется в их списках галопом
+        std::vector<MinusWordProbe> minus_probes;
+        std::optional<std::vector<int>> positional_matches;
+        PostingsUnion postings;
+        // Для запросов с minimum_match > 1: объединение содержит только самые редкие группы,
+        // а отбор и релевантность считает matcher
+        std::optional<PostingsMatcher> matcher;
+    };
+
+    // План запроса: списки плюс-слов объединяются, если их нет — дальше ничего не вычисляется.
+    // Фразы пересекаются начиная с самого редкого слова. Минус-слово, документов у которого не больше,
+    // чем кандидатов, выписывается в docs_with_minus_word, остальные проверяются только у кандидатов
+    [[nodiscard]] ScoringCursor StartScoring(const Query &query) const;
+
+    // Заполняет cursor.matcher и объединение кандидатов для запроса с minimum_match > 1; возвращает число кандидатов
+    size_t StartMinimumMatch(const Query &query, ScoringCursor &cursor) const;
+
+    [[nodiscard]] static bool HasMinusWord(ScoringCursor &cursor, int document_id) {
+        for (MinusWordProbe &probe: cursor.minus_probes) {
+            probe.position = probe.postings->Seek(document_id, probe.position);
+            if (probe.position < probe.postings->size() && probe.postings->DocumentId(probe.position) == document_id) {
+                return true;
             }
         }
+        return false;
+    }
 
-        std::vector<Document> matched_documents;
-        matched_documents.reserve(document_to_relevance.size());
-        for (const auto[document_id, relevance] : document_to_relevance) {
-            matched_documents.emplace_back(document_id, relevance, documents_.at(document_id).rating);
+    // Обрабатывает не больше max_documents документов объединения; true, когда списки исчерпаны
+    template<typename DocumentPredicate>
+    bool ContinueScoring(ScoringCursor &cursor, const DocumentPredicate &document_predicate, size_t max_documents,
+                         std::vector<Document> &matched_documents) const {
+        const auto &minus = cursor.docs_with_minus_word;
+        int document_id = 0;
+        double relevance = 0.0;
+        for (size_t processed = 0; processed < max_documents; ++processed) {
+            if (!cursor.postings.Next(document_id, relevance)) {
+                return true;
+            }
+            while (cursor.minus_position < minus.size() && minus[cursor.minus_position] < document_id) {
+                ++cursor.minus_position;
+            }
+            if (cursor.minus_position < minus.size() && minus[cursor.minus_position] == document_id) {
+                continue;
+            }
+            if (cursor.positional_matches && !std::binary_search(cursor.positional_matches->cbegin(),
+                                                                 cursor.positional_matches->cend(), document_id)) {
+                continue;
+            }
+            if (HasMinusWord(cursor, document_id)) {
+                continue;
+            }
+            if (cursor.matcher && !cursor.matcher->Match(document_id, relevance)) {
+                continue;
+            }
+            const auto &document_data = documents_.at(document_id);
+            if (document_predicate(document_id, document_data.status, document_data.rating)) {
+                matched_documents.emplace_back(document_id, relevance, document_data.rating);
+            }
         }
+        return false;
+    }
 
+    template<typename DocumentPredicate>
+    std::vector<Document>
+    FindAllDocumentsSequenced(const Query &query, const DocumentPredicate &document_predicate) const {
+        ScoringCursor cursor = StartScoring(query);
+
+        TRACE_STAGE(SCORING);
+        std::vector<Document> matched_documents;
+        ContinueScoring(cursor, document_predicate, std::numeric_limits<size_t>::max(), matched_documents);
         return matched_documents;
     }
 
@@ -278,43 +891,59 @@ private:
     std::vector<Document>
     FindAllDocumentsParallel(const Query &query, const DocumentPredicate &document_predicate) const {
 
-        // Найдем документы с минус-словами
-        std::set<int> docs_with_minus_word;
-        std::mutex m1;
-        auto begin = query.minus_words.cbegin();
-        auto end = query.minus_words.cend();
-        std::for_each(std::execution::par, document_to_word_freqs_.cbegin(), document_to_word_freqs_.cend(),
-                      [begin, end, &docs_with_minus_word, &m1](const auto &item) {
-                          const auto document_id = item.first;
-                          const auto &word_freqs = item.second;
-                          if (std::any_of(begin, end, [&word_freqs, document_id, &docs_with_minus_word](
-                                  const auto &word) { return word_freqs.count(word); })) {
-                              m1.lock();
-                              docs_with_minus_word.insert(document_id);
-                              m1.unlock();
-                          }
-                      });
-
-        std::unordered_map<std::string_view, double> inverse_document_freq;
+        std::vector<std::pair<std::string_view, double>> inverse_document_freq;
+        inverse_document_freq.reserve(query.plus_words.size());
         for (const auto& word: query.plus_words) {
-            inverse_document_freq[word] = ComputeWordInverseDocumentFreq(word);
+            if (const auto it = word_to_document_freqs_.find(word); it != word_to_document_freqs_.end() && !it->second.empty()) {
+                inverse_document_freq.emplace_back(word, GetInverseDocumentFreq(it->second) * GetQueryWordWeight(query, word));
+            }
+        }
+        if (inverse_document_freq.empty()) {
+            return {};
+        }
+
+        std::optional<std::vector<int>> positional_matches;
+        {
+            TRACE_STAGE(CANDIDATES);
+            positional_matches = FindPositionalMatches(query);
+            if (positional_matches && positional_matches->empty()) {
+                return {};
+            }
         }
 
+        TRACE_STAGE(SCORING);
+        // Минус-слова и фразы проверяются только у документов, в которых нашлось плюс-слово
         ConcurrentMap<int, double> document_to_relevance_concurrent(8);
         const auto &docs = documents_;
+        const auto &minus_words = query.minus_words;
         std::for_each(std::execution::par, document_to_word_freqs_.cbegin(), document_to_word_freqs_.cend(),
-                      [&docs_with_minus_word, &docs, &inverse_document_freq, document_predicate, &document_to_relevance_concurrent](const auto &item) {
+                      [&query, &minus_words, &positional_matches, &docs, &inverse_document_freq, document_predicate, &document_to_relevance_concurrent](const auto &item) {
                           const auto document_id = item.first;
                           const auto &word_freqs = item.second;
-                          if (docs_with_minus_word.count(document_id) == 0) {
-                              for (const auto& [word, inverse_freq]: inverse_document_freq) {
-                                  if (word_freqs.count(word) == 0) { continue; }
-                                  const auto &document_data = docs.at(document_id);
-                                  if (document_predicate(document_id, document_data.status, document_data.rating)) {
-                                      document_to_relevance_concurrent[document_id].ref_to_value += word_freqs.at(word) * inverse_freq;
-                                  }
+                          double relevance = 0.0;
+                          bool matched = false;
+                          for (const auto& [word, inverse_freq]: inverse_document_freq) {
+                              if (const auto it = word_freqs.find(word); it != word_freqs.end()) {
+                                  relevance += it->second * inverse_freq;
+                                  matched = true;
                               }
                           }
+                          if (!matched || std::any_of(minus_words.begin(), minus_words.end(), [&word_freqs](const auto &word) {
+                              return word_freqs.count(word) > 0;
+                          })) {
+                              return;
+                          }
+                          if (!HasMinimumMatch(query, word_freqs)) {
+                              return;
+                          }
+                          if (positional_matches && !std::binary_search(positional_matches->cbegin(),
+                                                                        positional_matches->cend(), document_id)) {
+                              return;
+                          }
+                          const auto &document_data = docs.at(document_id);
+                          if (document_predicate(document_id, document_data.status, document_data.rating)) {
+                              document_to_relevance_concurrent[document_id].ref_to_value = relevance;
+                          }
                       });
 
         std::map<int, double> document_to_relevance = document_to_relevance_concurrent.BuildOrdinaryMap();
@@ -337,7 +966,7 @@ private:
     template<typename ExecutionPolicy, typename DocumentPredicate>
     std::vector<Document>
     FindAllDocuments(ExecutionPolicy &&, const Query &query, const DocumentPredicate &document_predicate) const {
-        if constexpr(std::is_same_v<ExecutionPolicy, std::execution::sequenced_policy>) {
+        if constexpr(std::is_same_v<std::decay_t<ExecutionPolicy>, std::execution::sequenced_policy>) {
             return FindAllDocumentsSequenced(query, document_predicate);
         } else {
             return FindAllDocumentsParallel(query, document_predicate);
@@ -0,0 +1,225 @@
+#include "search_server.h"
+#include "process_queries.h"
+#include "remove_duplicates.h"
+#include "generators.h"
+
+#include <benchmark/benchmark.h>
+
+#include <algorithm>
+#include <chrono>
+#include <execution>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <random>
+#include <sstream>
+#include <string>
+#include <tuple>
+#include <vector>
+
+// Воспроизводимые замеры на синтетическом корпусе. Аргументы каждого замера:
+// число документов, размер словаря и показатель распределения Ципфа, умноженный на 100 (0 — равномерное).
+// JSON для сравнения между релизами: --benchmark_out=result.json --benchmark_out_format=json
+
+using namespace std;
+
+namespace {
+const int WORDS_PER_DOCUMENT = 50;
+const int WORDS_PER_QUERY = 5;
+const double MINUS_WORD_PROBABILITY = 0.1;
+const int QUERY_COUNT = 1000;
+const int STOP_WORD_COUNT = 3;
+const int QUERY_BATCH_SIZE = 100;
+
+struct Corpus {
+    vector<string> vocabulary;
+    string stop_words;
+    vector<string> documents;
+    vector<string> queries;
+};
+
+using CorpusKey = tuple<int64_t, int64_t, int64_t>;
+
+CorpusKey GetCorpusKey(const benchmark::State &state) {
+    return {state.range(0), state.range(1), state.range(2)};
+}
+
+const Corpus &GetCorpus(const CorpusKey &key) {
+    static map<CorpusKey, Corpus> corpora;
+    if (const auto it = corpora.find(key); it != corpora.end()) {
+        return it->second;
+    }
+    const auto[document_count, vocabulary_size, zipf_percent] = key;
+    // Зерно зависит только от параметров, поэтому корпус одинаков между запусками
+    mt19937 generator(static_cast<unsigned>(document_count * 31 + vocabulary_size * 7 + zipf_percent));
+
+    Corpus corpus;
+    corpus.vocabulary = GenerateVocabulary(generator, static_cast<int>(vocabulary_size), 10);
+    for (int i = 0; i < STOP_WORD_COUNT; ++i) {
+        corpus.stop_words += corpus.vocabulary[i] + ' ';
+    }
+    ZipfWordGenerator words(corpus.vocabulary, zipf_percent / 100.0);
+    corpus.documents = GenerateZipfTexts(generator, words, static_cast<int>(document_count), WORDS_PER_DOCUMENT);
+    corpus.queries = GenerateZipfTexts(generator, words, QUERY_COUNT, WORDS_PER_QUERY, MINUS_WORD_PROBABILITY);
+    return corpora.emplace(key, move(corpus)).first->second;
+}
+
+unique_ptr<SearchServer> BuildServer(const Corpus &corpus, size_t document_count) {
+    auto search_server = make_unique<SearchServer>(corpus.stop_words);
+    for (size_t i = 0; i < document_count; ++i) {
+        search_server->AddDocument(static_cast<int>(i), corpus.documents[i], DocumentStatus::ACTUAL, {1, 2, 3});
+    }
+    return search_server;
+}
+
+const SearchServer &GetServer(const CorpusKey &key) {
+    static map<CorpusKey, unique_ptr<SearchServer>> servers;
+    auto &search_server = servers[key];
+    if (!search_server) {
+        const auto &corpus = GetCorpus(key);
+        search_server = BuildServer(corpus, corpus.documents.size());
+    }
+    return *search_server;
+}
+
+// Перцентили задержки отдельных операций в микросекундах
+class LatencyRecorder {
+public:
+    using Clock = chrono::steady_clock;
+
+    void Add(Clock::duration duration) {
+        latencies_.push_back(chrono::duration<double, micro>(duration).count());
+    }
+
+    void Report(benchmark::State &state) {
+        if (latencies_.empty()) {
+            return;
+        }
+        sort(latencies_.begin(), latencies_.end());
+        const auto percentile = [this](double fraction) {
+            return latencies_[min(latencies_.size() - 1, static_cast<size_t>(fraction * latencies_.size()))];
+        };
+        state.counters["p50_us"] = percentile(0.5);
+        state.counters["p90_us"] = percentile(0.9);
+        state.counters["p99_us"] = percentile(0.99);
+        state.counters["max_us"] = latencies_.back();
+    }
+
+private:
+    vector<double> latencies_;
+};
+
+void CorpusArguments(benchmark::internal::Benchmark *benchmark) {
+    benchmark->ArgNames({"docs", "vocab", "zipf"});
+    benchmark->ArgsProduct({{1'000, 10'000}, {1'000, 10'000}, {0, 110}});
+}
+
+void BM_AddDocument(benchmark::State &state) {
+    const auto &corpus = GetCorpus(GetCorpusKey(state));
+    for (auto _ : state) {
+        auto search_server = make_unique<SearchServer>(corpus.stop_words);
+        for (size_t i = 0; i < corpus.documents.size(); ++i) {
+            search_server->AddDocument(static_cast<int>(i), corpus.documents[i], DocumentStatus::ACTUAL, {1, 2, 3});
+        }
+        state.PauseTiming();
+        search_server.reset();
+        state.ResumeTiming();
+    }
+    state.SetItemsProcessed(state.iterations() * static_cast<int64_t>(corpus.documents.size()));
+}
+
+template<typename ExecutionPolicy>
+void BM_FindTopDocuments(benchmark::State &state, ExecutionPolicy policy) {
+    const auto &corpus = GetCorpus(GetCorpusKey(state));
+    const auto &search_server = GetServer(GetCorpusKey(state));
+    LatencyRecorder latencies;
+    size_t query_index = 0;
+    for (auto _ : state) {
+        const auto start_time = LatencyRecorder::Clock::now();
+        benchmark::DoNotOptimize(search_server.FindTopDocuments(policy, corpus.queries[query_index]));
+        latencies.Add(LatencyRecorder::Clock::now() - start_time);
+        query_index = (query_index + 1) % corpus.queries.size();
+    }
+    latencies.Report(state);
+    state.SetItemsProcessed(state.iterations());
+}
+
+void BM_MatchDocument(benchmark::State &state) {
+    const auto &corpus = GetCorpus(GetCorpusKey(state));
+    const auto &search_server = GetServer(GetCorpusKey(state));
+    LatencyRecorder latencies;
+    size_t query_index = 0;
+    int document_id = 0;
+    for (auto _ : state) {
+        const auto start_time = LatencyRecorder::Clock::now();
+        benchmark::DoNotOptimize(search_server.MatchDocument(corpus.queries[query_index], document_id));
+        latencies.Add(LatencyRecorder::Clock::now() - start_time);
+        query_index = (query_index + 1) % corpus.queries.size();
+        document_id = (document_id + 7919) % static_cast<int>(corpus.documents.size());
+    }
+    latencies.Report(state);
+    state.SetItemsProcessed(state.iterations());
+}
+
+void BM_RemoveDocument(benchmark::State &state) {
+    const auto &corpus = GetCorpus(GetCorpusKey(state));
+    unique_ptr<SearchServer> search_server;
+    int document_id = 0;
+    LatencyRecorder latencies;
+    for (auto _ : state) {
+        if (!search_server || document_id == static_cast<int>(corpus.documents.size())) {
+            state.PauseTiming();
+            search_server = BuildServer(corpus, corpus.documents.size());
+            document_id = 0;
+            state.ResumeTiming();
+        }
+        const auto start_time = LatencyRecorder::Clock::now();
+        search_server->RemoveDocument(document_id++);
+        latencies.Add(LatencyRecorder::Clock::now() - start_time);
+    }
+    latencies.Report(state);
+    state.SetItemsProcessed(state.iterations());
+}
+
+void BM_RemoveDuplicates(benchmark::State &state) {
+    const auto &corpus = GetCorpus(GetCorpusKey(state));
+    // RemoveDuplicates сообщает о каждом дубликате в cout, на время замера вывод глушится
+    ostringstream sink;
+    auto *const cout_buffer = cout.rdbuf(sink.rdbuf());
+    for (auto _ : state) {
+        state.PauseTiming();
+        auto search_server = BuildServer(corpus, corpus.documents.size());
+        // Каждый десятый документ повторяется
+        for (size_t i = 0; i < corpus.documents.size(); i += 10) {
+            search_server->AddDocument(static_cast<int>(corpus.documents.size() + i), corpus.documents[i],
+                                       DocumentStatus::ACTUAL, {1, 2, 3});
+        }
+        sink.str({});
+        state.ResumeTiming();
+        RemoveDuplicates(*search_server);
+    }
+    cout.rdbuf(cout_buffer);
+    state.SetItemsProcessed(state.iterations() * static_cast<int64_t>(corpus.documents.size()));
+}
+
+void BM_ProcessQueries(benchmark::State &state) {
+    const auto &corpus = GetCorpus(GetCorpusKey(state));
+    const auto &search_server = GetServer(GetCorpusKey(state));
+    const vector<string> queries(corpus.queries.begin(), corpus.queries.begin() + QUERY_BATCH_SIZE);
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(ProcessQueries(search_server, queries));
+    }
+    state.SetItemsProcessed(state.iterations() * QUERY_BATCH_SIZE);
+}
+}
+
+BENCHMARK(BM_AddDocument)->Apply(CorpusArguments)->Unit(benchmark::kMillisecond);
+BENCHMARK_CAPTURE(BM_FindTopDocuments, seq, std::execution::seq)->Apply(CorpusArguments)->Unit(benchmark::kMicrosecond);
+BENCHMARK_CAPTURE(BM_FindTopDocuments, par, std::execution::par)->Apply(CorpusArguments)->Unit(benchmark::kMicrosecond);
+BENCHMARK(BM_MatchDocument)->Apply(CorpusArguments)->Unit(benchmark::kMicrosecond);
+BENCHMARK(BM_RemoveDocument)->Apply(CorpusArguments)->Unit(benchmark::kMicrosecond);
+BENCHMARK(BM_RemoveDuplicates)->ArgNames({"docs", "vocab", "zipf"})
+        ->ArgsProduct({{250, 1'000}, {1'000}, {0, 110}})->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_ProcessQueries)->Apply(CorpusArguments)->Unit(benchmark::kMillisecond);
+
+BENCHMARK_MAIN();
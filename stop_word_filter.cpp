@@ -0,0 +1,28 @@
+#include "stop_word_filter.h"
+
+using namespace std;
+
+StopWordFilter::StopWordFilter(const std::set<std::string, std::less<>> &words)
+        : words_(words.begin(), words.end()) {
+    vector<string_view> views(words_.begin(), words_.end());
+    StopWordLayout layout = BuildStopWordLayout(views);
+    seed_ = layout.seed;
+    displacements_ = move(layout.displacements);
+    slots_ = move(layout.slots);
+    ComputeLengthRange();
+}
+
+StopWordFilter::StopWordFilter(std::vector<std::string> words, StopWordLayout layout)
+        : words_(move(words))
+        , seed_(layout.seed)
+        , displacements_(move(layout.displacements))
+        , slots_(move(layout.slots)) {
+    ComputeLengthRange();
+}
+
+void StopWordFilter::ComputeLengthRange() {
+    for (const string &word: words_) {
+        min_length_ = min(min_length_, word.size());
+        max_length_ = max(max_length_, word.size());
+    }
+}
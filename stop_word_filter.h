@@ -0,0 +1,205 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <numeric>
+#include <set>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Множество стоп-слов как совершенная хеш-таблица по схеме hash-and-displace: слово попадает в корзину
+// по старшим битам хеша, у каждой корзины своё смещение, разводящее её слова по свободным ячейкам.
+// Проверка слова — один хеш, одна ячейка и одно сравнение строк; слова, длина которых вне диапазона
+// длин стоп-слов, отсекаются без хеширования. Построение работает и во время компиляции (StaticStopWords)
+
+constexpr uint64_t HashStopWord(std::string_view word, uint64_t seed) {
+    // FNV-1a с финальным перемешиванием из splitmix64
+    uint64_t hash = 14695981039346656037ull ^ (seed * 0x9E3779B97F4A7C15ull);
+    for (const char c: word) {
+        hash ^= static_cast<uint8_t>(c);
+        hash *= 1099511628211ull;
+    }
+    hash ^= hash >> 30;
+    hash *= 0xBF58476D1CE4E5B9ull;
+    hash ^= hash >> 27;
+    hash *= 0x94D049BB133111EBull;
+    hash ^= hash >> 31;
+    return hash;
+}
+
+// Ячеек в 1.25..2.5 раза больше слов, корзин вдвое меньше слов
+constexpr size_t GetStopWordSlotCount(size_t word_count) {
+    return std::bit_ceil(word_count + word_count / 4 + 1);
+}
+
+constexpr size_t GetStopWordBucketCount(size_t word_count) {
+    return word_count / 2 + 1;
+}
+
+struct StopWordPosition {
+    size_t bucket;
+    uint32_t base;
+    uint32_t step;
+};
+
+constexpr StopWordPosition LocateStopWord(std::string_view word, uint64_t seed, size_t bucket_count) {
+    const uint64_t hash = HashStopWord(word, seed);
+    return {static_cast<size_t>(((hash >> 32) * bucket_count) >> 32),
+            static_cast<uint32_t>(hash),
+            static_cast<uint32_t>((hash * 0x9E3779B97F4A7C15ull) >> 32) | 1u};
+}
+
+constexpr size_t GetStopWordSlot(const StopWordPosition &position, uint32_t displacement, size_t slot_count) {
+    return (position.base + displacement * position.step) & (slot_count - 1);
+}
+
+struct StopWordLayout {
+    uint64_t seed = 0;
+    std::vector<uint32_t> displacements;
+    // Индекс слова в ячейке или -1
+    std::vector<int32_t> slots;
+};
+
+// words — различные непустые слова. Бросает std::logic_error, если раскладку не удалось подобрать
+// (возможно только при совпадении 64-битных хешей)
+constexpr StopWordLayout BuildStopWordLayout(const std::vector<std::string_view> &words) {
+    constexpr uint64_t MAX_SEED = 64;
+    const size_t slot_count = GetStopWordSlotCount(words.size());
+    const size_t bucket_count = GetStopWordBucketCount(words.size());
+    const auto max_displacement = static_cast<uint32_t>(4 * slot_count);
+
+    for (uint64_t seed = 0; seed < MAX_SEED; ++seed) {
+        StopWordLayout layout{seed, std::vector<uint32_t>(bucket_count, 0), std::vector<int32_t>(slot_count, -1)};
+        std::vector<std::vector<uint32_t>> buckets(bucket_count);
+        for (size_t i = 0; i < words.size(); ++i) {
+            buckets[LocateStopWord(words[i], seed, bucket_count).bucket].push_back(static_cast<uint32_t>(i));
+        }
+        // Большие корзины размещаются первыми, пока свободных ячеек много
+        std::vector<size_t> order(bucket_count);
+        std::iota(order.begin(), order.end(), size_t{0});
+        std::sort(order.begin(), order.end(), [&buckets](size_t lhs, size_t rhs) {
+            return buckets[lhs].size() > buckets[rhs].size()
+                   || (buckets[lhs].size() == buckets[rhs].size() && lhs < rhs);
+        });
+
+        bool placed_all = true;
+        std::vector<size_t> chosen;
+        for (const size_t bucket: order) {
+            if (buckets[bucket].empty()) {
+                break;
+            }
+            bool placed = false;
+            for (uint32_t displacement = 0; displacement < max_displacement && !placed; ++displacement) {
+                chosen.clear();
+                placed = true;
+                for (const uint32_t word: buckets[bucket]) {
+                    const size_t slot = GetStopWordSlot(LocateStopWord(words[word], seed, bucket_count),
+                                                        displacement, slot_count);
+                    if (layout.slots[slot] != -1 || std::find(chosen.begin(), chosen.end(), slot) != chosen.end()) {
+                        placed = false;
+                        break;
+                    }
+                    chosen.push_back(slot);
+                }
+                if (placed) {
+                    layout.displacements[bucket] = displacement;
+                    for (size_t k = 0; k < chosen.size(); ++k) {
+                        layout.slots[chosen[k]] = static_cast<int32_t>(buckets[bucket][k]);
+                    }
+                }
+            }
+            if (!placed) {
+                placed_all = false;
+                break;
+            }
+        }
+        if (placed_all) {
+            return layout;
+        }
+    }
+    throw std::logic_error("Cannot build a perfect hash for stop words");
+}
+
+class StopWordFilter {
+public:
+    StopWordFilter() = default;
+
+    explicit StopWordFilter(const std::set<std::string, std::less<>> &words);
+
+    // Готовая раскладка, например посчитанная при компиляции в StaticStopWords
+    StopWordFilter(std::vector<std::string> words, StopWordLayout layout);
+
+    [[nodiscard]] bool Contains(std::string_view word) const {
+        if (word.size() < min_length_ || word.size() > max_length_) {
+            return false;
+        }
+        const auto position = LocateStopWord(word, seed_, displacements_.size());
+        const int32_t index = slots_[GetStopWordSlot(position, displacements_[position.bucket], slots_.size())];
+        return index >= 0 && words_[index] == word;
+    }
+
+    [[nodiscard]] const std::vector<std::string> &GetWords() const {
+        return words_;
+    }
+
+private:
+    std::vector<std::string> words_;
+    uint64_t seed_ = 0;
+    std::vector<uint32_t> displacements_;
+    std::vector<int32_t> slots_;
+    // Пустое множество: ни одна длина не подходит
+    size_t min_length_ = SIZE_MAX;
+    size_t max_length_ = 0;
+
+    void ComputeLengthRange();
+};
+
+// Стоп-слова, известные при компиляции:
+//     constexpr StaticStopWords STOP_WORDS(std::array{"and"sv, "in"sv, "on"sv});
+// Таблица строится компилятором, а SearchServer только копирует её. Слова должны быть различными и непустыми,
+// иначе объявление constexpr не скомпилируется
+template<size_t N>
+class StaticStopWords {
+public:
+    static constexpr size_t SLOT_COUNT = GetStopWordSlotCount(N);
+    static constexpr size_t BUCKET_COUNT = GetStopWordBucketCount(N);
+
+    constexpr explicit StaticStopWords(const std::array<std::string_view, N> &words)
+            : words_(words) {
+        std::vector<std::string_view> sorted(words.begin(), words.end());
+        std::sort(sorted.begin(), sorted.end());
+        if (std::adjacent_find(sorted.begin(), sorted.end()) != sorted.end()
+            || std::any_of(sorted.begin(), sorted.end(), [](std::string_view word) { return word.empty(); })) {
+            throw std::invalid_argument("Static stop words must be distinct and non-empty");
+        }
+        const StopWordLayout layout = BuildStopWordLayout(std::vector<std::string_view>(words.begin(), words.end()));
+        seed_ = layout.seed;
+        std::copy(layout.displacements.begin(), layout.displacements.end(), displacements_.begin());
+        std::copy(layout.slots.begin(), layout.slots.end(), slots_.begin());
+    }
+
+    [[nodiscard]] constexpr bool Contains(std::string_view word) const {
+        if (N == 0 || word.empty()) {
+            return false;
+        }
+        const auto position = LocateStopWord(word, seed_, BUCKET_COUNT);
+        const int32_t index = slots_[GetStopWordSlot(position, displacements_[position.bucket], SLOT_COUNT)];
+        return index >= 0 && words_[index] == word;
+    }
+
+    [[nodiscard]] StopWordFilter ToFilter() const {
+        return StopWordFilter(std::vector<std::string>(words_.begin(), words_.end()),
+                              {seed_, {displacements_.begin(), displacements_.end()}, {slots_.begin(), slots_.end()}});
+    }
+
+private:
+    std::array<std::string_view, N> words_;
+    uint64_t seed_ = 0;
+    std::array<uint32_t, BUCKET_COUNT> displacements_{};
+    std::array<int32_t, SLOT_COUNT> slots_{};
+};
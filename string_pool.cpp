@@ -0,0 +1,52 @@
+#include "string_pool.h"
+
+#include <algorithm>
+#include <cstring>
+
+using namespace std;
+
+StringPool::StringPool(std::pmr::memory_resource* upstream, size_t chunk_size)
+        : upstream_(upstream), chunk_size_(chunk_size) {
+}
+
+StringPool::~StringPool() {
+    for (const Chunk& chunk: chunks_) {
+        upstream_->deallocate(chunk.data, chunk.size, alignof(char));
+    }
+}
+
+std::string_view StringPool::Intern(std::string_view text) {
+    if (text.empty()) {
+        return {};
+    }
+    if (chunks_.empty() || chunks_.back().size - chunk_offset_ < text.size()) {
+        // Блоки растут вдвое до chunk_size_, чтобы маленький словарь не занимал целый блок.
+        // Длинная строка получает собственный блок, текущий блок при этом остаётся открытым
+        const size_t next_size = chunks_.empty() ? MIN_CHUNK_SIZE : min(chunk_size_, chunks_.back().size * 2);
+        const size_t size = max(next_size, text.size());
+        Chunk chunk{static_cast<char*>(upstream_->allocate(size, alignof(char))), size};
+        reserved_bytes_ += size;
+        if (size > next_size && !chunks_.empty()) {
+            chunks_.insert(prev(chunks_.end()), chunk);
+            memcpy(chunk.data, text.data(), text.size());
+            used_bytes_ += text.size();
+            return {chunk.data, text.size()};
+        }
+        chunks_.push_back(chunk);
+        chunk_offset_ = 0;
+    }
+    char* const destination = chunks_.back().data + chunk_offset_;
+    memcpy(destination, text.data(), text.size());
+    chunk_offset_ += text.size();
+    used_bytes_ += text.size();
+    return {destination, text.size()};
+}
+
+void StringPool::Swap(StringPool& other) noexcept {
+    swap(upstream_, other.upstream_);
+    swap(chunk_size_, other.chunk_size_);
+    chunks_.swap(other.chunks_);
+    swap(chunk_offset_, other.chunk_offset_);
+    swap(used_bytes_, other.used_bytes_);
+    swap(reserved_bytes_, other.reserved_bytes_);
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <cstddef>
+#include <memory_resource>
+#include <string_view>
+#include <vector>
+
+// Непрерывное хранилище байтов строк: строки укладываются подряд в крупные блоки,
+// освобождается всё сразу вместе с пулом. Строки не перемещаются, string_view на них стабильны
+class StringPool {
+public:
+    static constexpr size_t MIN_CHUNK_SIZE = 1024;
+    static constexpr size_t DEFAULT_CHUNK_SIZE = 64 * 1024;
+
+    explicit StringPool(std::pmr::memory_resource *upstream = std::pmr::get_default_resource(),
+                        size_t chunk_size = DEFAULT_CHUNK_SIZE);
+
+    StringPool(const StringPool &) = delete;
+
+    StringPool &operator=(const StringPool &) = delete;
+
+    ~StringPool();
+
+    std::string_view Intern(std::string_view text);
+
+    // Обмен содержимым, например со свежим пулом, в который перенесены только живые строки
+    void Swap(StringPool &other) noexcept;
+
+    // Сколько байт занято строками
+    [[nodiscard]] size_t GetUsedBytes() const {
+        return used_bytes_;
+    }
+
+    // Сколько байт взято у вышестоящего ресурса
+    [[nodiscard]] size_t GetReservedBytes() const {
+        return reserved_bytes_;
+    }
+
+private:
+    struct Chunk {
+        char *data;
+        size_t size;
+    };
+
+    std::pmr::memory_resource *upstream_;
+    size_t chunk_size_;
+    std::vector<Chunk> chunks_;
+    size_t chunk_offset_ = 0;
+    size_t used_bytes_ = 0;
+    size_t reserved_bytes_ = 0;
+};
@@ -0,0 +1,160 @@
+#pragma once
+
+#include <condition_variable>
+#include <coroutine>
+#include <exception>
+#include <mutex>
+#include <optional>
+#include <utility>
+
+// Ленивая корутина с результатом типа T: начинает выполняться, когда её ждут через co_await,
+// и по завершении сразу возобновляет ожидающую корутину (symmetric transfer, без роста стека)
+template<typename T>
+class Task {
+public:
+    struct promise_type {
+        std::optional<T> value;
+        std::exception_ptr exception;
+        std::coroutine_handle<> continuation = std::noop_coroutine();
+
+        Task get_return_object() {
+            return Task(std::coroutine_handle<promise_type>::from_promise(*this));
+        }
+
+        std::suspend_always initial_suspend() noexcept {
+            return {};
+        }
+
+        struct FinalAwaiter {
+            bool await_ready() noexcept {
+                return false;
+            }
+
+            std::coroutine_handle<> await_suspend(std::coroutine_handle<promise_type> handle) noexcept {
+                return handle.promise().continuation;
+            }
+
+            void await_resume() noexcept {
+            }
+        };
+
+        FinalAwaiter final_suspend() noexcept {
+            return {};
+        }
+
+        template<typename U>
+        void return_value(U &&result) {
+            value.emplace(std::forward<U>(result));
+        }
+
+        void unhandled_exception() {
+            exception = std::current_exception();
+        }
+    };
+
+    Task(Task &&other) noexcept
+            : handle_(std::exchange(other.handle_, nullptr)) {
+    }
+
+    Task &operator=(Task &&other) noexcept {
+        if (this != &other) {
+            Reset();
+            handle_ = std::exchange(other.handle_, nullptr);
+        }
+        return *this;
+    }
+
+    Task(const Task &) = delete;
+
+    Task &operator=(const Task &) = delete;
+
+    ~Task() {
+        Reset();
+    }
+
+    bool await_ready() const noexcept {
+        return !handle_ || handle_.done();
+    }
+
+    std::coroutine_handle<> await_suspend(std::coroutine_handle<> awaiting) noexcept {
+        handle_.promise().continuation = awaiting;
+        return handle_;
+    }
+
+    T await_resume() {
+        auto &promise = handle_.promise();
+        if (promise.exception) {
+            std::rethrow_exception(promise.exception);
+        }
+        return std::move(*promise.value);
+    }
+
+private:
+    std::coroutine_handle<promise_type> handle_;
+
+    explicit Task(std::coroutine_handle<promise_type> handle)
+            : handle_(handle) {
+    }
+
+    void Reset() {
+        if (handle_) {
+            handle_.destroy();
+            handle_ = nullptr;
+        }
+    }
+};
+
+// Корутина без результата, которая начинает работу сразу и сама освобождает кадр по завершении
+struct DetachedTask {
+    struct promise_type {
+        DetachedTask get_return_object() {
+            return {};
+        }
+
+        std::suspend_never initial_suspend() noexcept {
+            return {};
+        }
+
+        std::suspend_never final_suspend() noexcept {
+            return {};
+        }
+
+        void return_void() {
+        }
+
+        void unhandled_exception() {
+            std::terminate();
+        }
+    };
+};
+
+// Блокирует вызывающий поток до завершения задачи и возвращает её результат или бросает её исключение.
+// Для вызова из синхронного кода; внутри корутин задачу нужно ждать через co_await
+template<typename T>
+T SyncWait(Task<T> task) {
+    std::optional<T> result;
+    std::exception_ptr exception;
+    std::mutex m;
+    std::condition_variable finished;
+    bool done = false;
+
+    const auto run = [&]() -> DetachedTask {
+        try {
+            result.emplace(co_await std::move(task));
+        } catch (...) {
+            exception = std::current_exception();
+        }
+        // Уведомление под мьютексом: после wait вызывающий поток сразу разрушает finished
+        std::lock_guard guard(m);
+        done = true;
+        finished.notify_one();
+    };
+    run();
+
+    std::unique_lock lock(m);
+    finished.wait(lock, [&done] { return done; });
+    if (exception) {
+        std::rethrow_exception(exception);
+    }
+    return std::move(*result);
+}
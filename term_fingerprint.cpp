@@ -0,0 +1,38 @@
+#include "term_fingerprint.h"
+
+#include <algorithm>
+
+using namespace std;
+
+namespace {
+uint64_t HashTerm(string_view prefix, string_view word) {
+    // FNV-1a с финальным перемешиванием из splitmix64: после него сумма хешей не вырождается
+    uint64_t hash = 14695981039346656037ull;
+    for (const string_view part: {prefix, word}) {
+        for (const char c: part) {
+            hash ^= static_cast<uint8_t>(c);
+            hash *= 1099511628211ull;
+        }
+    }
+    hash ^= hash >> 30;
+    hash *= 0xBF58476D1CE4E5B9ull;
+    hash ^= hash >> 27;
+    hash *= 0x94D049BB133111EBull;
+    hash ^= hash >> 31;
+    return hash;
+}
+}
+
+void TermSetFingerprint::Add(const std::vector<std::string_view> &words, std::string_view prefix) {
+    hashes_.clear();
+    hashes_.reserve(words.size());
+    for (const string_view word: words) {
+        hashes_.push_back(HashTerm(prefix, word));
+    }
+    // Повторы слова учитываются один раз, а сумма не зависит от порядка
+    sort(hashes_.begin(), hashes_.end());
+    hashes_.erase(unique(hashes_.begin(), hashes_.end()), hashes_.end());
+    for (const uint64_t hash: hashes_) {
+        value_ += hash;
+    }
+}
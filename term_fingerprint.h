@@ -0,0 +1,40 @@
+#pragma once
+
+#include <cstdint>
+#include <string_view>
+#include <vector>
+
+// Что делать с документом, множество слов которого совпадает с уже добавленным
+enum class DuplicatePolicy {
+    // Дубликаты не ищутся
+    ALLOW,
+    // AddDocument бросает std::invalid_argument
+    REJECT,
+    // Старый документ удаляется, новый добавляется
+    REPLACE,
+    // Новый документ молча пропускается
+    KEEP_FIRST,
+};
+
+// Отпечаток множества различных слов документа: не зависит ни от порядка слов, ни от их повторов.
+// Документы с одинаковым множеством слов (дубликаты в смысле RemoveDuplicates) получают одинаковый отпечаток,
+// разные множества совпадают с вероятностью порядка 2^-64
+class TermSetFingerprint {
+public:
+    // Слова одного поля. Префикс приписывается к каждому слову, так слова разных полей не смешиваются
+    void Add(const std::vector<std::string_view> &words, std::string_view prefix = {});
+
+    [[nodiscard]] uint64_t Get() const {
+        return value_;
+    }
+
+private:
+    std::vector<uint64_t> hashes_;
+    uint64_t value_ = 0;
+};
+
+inline uint64_t ComputeTermSetFingerprint(const std::vector<std::string_view> &words) {
+    TermSetFingerprint fingerprint;
+    fingerprint.Add(words);
+    return fingerprint.Get();
+}
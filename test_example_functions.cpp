@@ -1,9 +1,22 @@
 #include "test_example_functions.h"
-#include "log_duration.h"
+#include "instrumentation.h"
+
+#include <numeric>
 
 using namespace std;
 using namespace std::literals::string_literals;
 
+namespace {
+// Время последнего запроса текущего потока по счётчикам этапов, в наносекундах. Без
+// SEARCH_SERVER_INSTRUMENTATION этапы не замеряются и строка не печатается
+void PrintLastQueryDuration() {
+#ifdef SEARCH_SERVER_INSTRUMENTATION
+    const QueryTrace& trace = GetLastQueryTrace();
+    cout << "Operation time: "s << accumulate(trace.begin(), trace.end(), uint64_t{0}) << " ns"s << endl;
+#endif
+}
+}
+
 void PrintDocument(const Document& document) {
     cout << "{ "s
          << "document_id = "s << document.id << ", "s
@@ -34,10 +47,10 @@ void AddDocument(SearchServer& search_server, int document_id, const string& doc
 void FindTopDocuments(const SearchServer& search_server, const string& raw_query) {
     cout << "Результаты поиска по запросу: "s << raw_query << endl;
     try {
-        LOG_DURATION_STREAM("Operation time"s, std::cout);
         for (const Document& document : search_server.FindTopDocuments(raw_query)) {
             PrintDocument(document);
         }
+        PrintLastQueryDuration();
     } catch (const invalid_argument& e) {
         cout << "Ошибка поиска: "s << e.what() << endl;
     }
@@ -46,11 +59,12 @@ void FindTopDocuments(const SearchServer& search_server, const string& raw_query
 void MatchDocuments(const SearchServer& search_server, const string& query) {
     try {
         cout << "Матчинг документов по запросу: "s << query << endl;
-        LOG_DURATION_STREAM("Operation time"s, std::cout);
+        TRACE_QUERY_BEGIN();
         for (const int document_id: search_server) {
             const auto [words, status] = search_server.MatchDocument(query, document_id);
             PrintMatchDocumentResult(document_id, words, status);
         }
+        PrintLastQueryDuration();
     } catch (const invalid_argument& e) {
         cout << "Ошибка матчинга документов на запрос "s << query << ": "s << e.what() << endl;
     }
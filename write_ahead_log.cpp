@@ -0,0 +1,599 @@
+#include "write_ahead_log.h"
+
+#include "document_loader.h"
+
+#include <array>
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+#include <filesystem>
+#include <future>
+#include <stdexcept>
+#include <unordered_map>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace std;
+
+namespace {
+const string_view WAL_MAGIC = "SSWAL001"sv;
+// Длина тела и его CRC-32
+const size_t RECORD_HEADER_SIZE = 2 * sizeof(uint32_t);
+// Сколько документов разбирается на слова, пока индексируется предыдущий блок
+const size_t REPLAY_BLOCK_SIZE = 4096;
+
+enum class WalRecordType : uint8_t {
+    ADD_DOCUMENT = 1,
+    REMOVE_DOCUMENT = 2,
+};
+
+constexpr array<uint32_t, 256> MakeCrc32Table() {
+    array<uint32_t, 256> table{};
+    for (uint32_t i = 0; i < table.size(); ++i) {
+        uint32_t crc = i;
+        for (int bit = 0; bit < 8; ++bit) {
+            crc = (crc & 1) ? (crc >> 1) ^ 0xEDB88320u : crc >> 1;
+        }
+        table[i] = crc;
+    }
+    return table;
+}
+
+uint32_t ComputeCrc32(string_view data) {
+    static constexpr array<uint32_t, 256> table = MakeCrc32Table();
+    uint32_t crc = 0xFFFFFFFFu;
+    for (const char c: data) {
+        crc = table[(crc ^ static_cast<uint8_t>(c)) & 0xFFu] ^ (crc >> 8);
+    }
+    return crc ^ 0xFFFFFFFFu;
+}
+
+template<typename Value>
+void Put(string &out, Value value) {
+    char bytes[sizeof(Value)];
+    memcpy(bytes, &value, sizeof(Value));
+    out.append(bytes, sizeof(Value));
+}
+
+void PutString(string &out, string_view text) {
+    Put(out, static_cast<uint32_t>(text.size()));
+    out.append(text);
+}
+
+// Читает тело записи; выход за его границы делает запись некорректной
+class PayloadReader {
+public:
+    explicit PayloadReader(string_view data) : data_(data) {
+    }
+
+    template<typename Value>
+    bool Get(Value &value) {
+        if (data_.size() < sizeof(Value)) {
+            return false;
+        }
+        memcpy(&value, data_.data(), sizeof(Value));
+        data_.remove_prefix(sizeof(Value));
+        return true;
+    }
+
+    bool GetString(string_view &text) {
+        uint32_t size = 0;
+        if (!Get(size) || data_.size() < size) {
+            return false;
+        }
+        text = data_.substr(0, size);
+        data_.remove_prefix(size);
+        return true;
+    }
+
+    [[nodiscard]] bool Finished() const {
+        return data_.empty();
+    }
+
+private:
+    string_view data_;
+};
+
+struct WalRecord {
+    // Запись целиком, с заголовком: контрольная точка копирует её без перекодирования
+    string_view bytes;
+    WalRecordType type = WalRecordType::REMOVE_DOCUMENT;
+    int document_id = 0;
+    DocumentStatus status = DocumentStatus::ACTUAL;
+    vector<int> ratings;
+    vector<DocumentField> fields;
+
+    [[nodiscard]] bool IsPlainText() const {
+        return fields.size() == 1 && fields.front().name == DEFAULT_FIELD;
+    }
+};
+
+string EncodeRecord(const string &payload) {
+    string record;
+    record.reserve(RECORD_HEADER_SIZE + payload.size());
+    Put(record, static_cast<uint32_t>(payload.size()));
+    Put(record, ComputeCrc32(payload));
+    record.append(payload);
+    return record;
+}
+
+string EncodeAddDocument(int document_id, const vector<DocumentField> &fields, DocumentStatus status,
+                         const vector<int> &ratings) {
+    string payload;
+    Put(payload, static_cast<uint8_t>(WalRecordType::ADD_DOCUMENT));
+    Put(payload, static_cast<int32_t>(document_id));
+    Put(payload, static_cast<int32_t>(status));
+    Put(payload, static_cast<uint32_t>(ratings.size()));
+    for (const int rating: ratings) {
+        Put(payload, static_cast<int32_t>(rating));
+    }
+    Put(payload, static_cast<uint32_t>(fields.size()));
+    for (const DocumentField &field: fields) {
+        PutString(payload, field.name);
+        PutString(payload, field.text);
+    }
+    return EncodeRecord(payload);
+}
+
+bool DecodeRecord(string_view payload, WalRecord &record) {
+    PayloadReader reader(payload);
+    uint8_t type = 0;
+    int32_t document_id = 0;
+    if (!reader.Get(type) || !reader.Get(document_id)) {
+        return false;
+    }
+    record.document_id = document_id;
+    if (type == static_cast<uint8_t>(WalRecordType::REMOVE_DOCUMENT)) {
+        record.type = WalRecordType::REMOVE_DOCUMENT;
+        return reader.Finished();
+    }
+    if (type != static_cast<uint8_t>(WalRecordType::ADD_DOCUMENT)) {
+        return false;
+    }
+    record.type = WalRecordType::ADD_DOCUMENT;
+    int32_t status = 0;
+    uint32_t count = 0;
+    if (!reader.Get(status) || status < 0 || status > static_cast<int32_t>(DocumentStatus::REMOVED)
+        || !reader.Get(count)) {
+        return false;
+    }
+    record.status = static_cast<DocumentStatus>(status);
+    // Размер проверяется чтением, а не reserve: испорченный счётчик не должен приводить к огромной аллокации
+    for (uint32_t i = 0; i < count; ++i) {
+        int32_t rating = 0;
+        if (!reader.Get(rating)) {
+            return false;
+        }
+        record.ratings.push_back(rating);
+    }
+    if (!reader.Get(count)) {
+        return false;
+    }
+    for (uint32_t i = 0; i < count; ++i) {
+        DocumentField field;
+        if (!reader.GetString(field.name) || !reader.GetString(field.text)) {
+            return false;
+        }
+        record.fields.push_back(field);
+    }
+    return reader.Finished();
+}
+
+// Возвращает длину корректного начала журнала: заголовок и записи до первой оборванной или повреждённой
+size_t ScanRecords(string_view data, vector<WalRecord> *records) {
+    if (data.size() < WAL_MAGIC.size()) {
+        // Оборванный при создании заголовок
+        if (WAL_MAGIC.substr(0, data.size()) != data) {
+            throw runtime_error("Not a write-ahead log"s);
+        }
+        return 0;
+    }
+    if (data.substr(0, WAL_MAGIC.size()) != WAL_MAGIC) {
+        throw runtime_error("Not a write-ahead log"s);
+    }
+    size_t offset = WAL_MAGIC.size();
+    while (data.size() - offset >= RECORD_HEADER_SIZE) {
+        uint32_t size = 0;
+        uint32_t crc = 0;
+        memcpy(&size, data.data() + offset, sizeof(size));
+        memcpy(&crc, data.data() + offset + sizeof(size), sizeof(crc));
+        if (data.size() - offset - RECORD_HEADER_SIZE < size) {
+            break;
+        }
+        const string_view payload = data.substr(offset + RECORD_HEADER_SIZE, size);
+        if (ComputeCrc32(payload) != crc) {
+            break;
+        }
+        WalRecord record;
+        if (!DecodeRecord(payload, record)) {
+            break;
+        }
+        record.bytes = data.substr(offset, RECORD_HEADER_SIZE + size);
+        if (records) {
+            records->push_back(move(record));
+        }
+        offset += RECORD_HEADER_SIZE + size;
+    }
+    return offset;
+}
+
+// Индексы последних записей каждого документа в порядке журнала
+vector<size_t> FindLastRecords(const vector<WalRecord> &records) {
+    unordered_map<int, size_t> last_record;
+    for (size_t i = 0; i < records.size(); ++i) {
+        last_record[records[i].document_id] = i;
+    }
+    vector<size_t> result;
+    result.reserve(last_record.size());
+    for (size_t i = 0; i < records.size(); ++i) {
+        if (last_record.at(records[i].document_id) == i) {
+            result.push_back(i);
+        }
+    }
+    return result;
+}
+
+void WriteAll(int fd, string_view data, const string &path) {
+    while (!data.empty()) {
+        const ssize_t written = write(fd, data.data(), data.size());
+        if (written < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            throw runtime_error("Cannot write "s + path + ": "s + strerror(errno));
+        }
+        data.remove_prefix(static_cast<size_t>(written));
+    }
+}
+
+void SyncFile(int fd, const string &path) {
+#ifdef __linux__
+    const int result = fdatasync(fd);
+#else
+    const int result = fsync(fd);
+#endif
+    if (result != 0) {
+        throw runtime_error("Cannot sync "s + path + ": "s + strerror(errno));
+    }
+}
+
+// Создание и переименование файла надёжны только после синхронизации каталога
+void SyncDirectory(const string &path) {
+    string directory = filesystem::path(path).parent_path().string();
+    if (directory.empty()) {
+        directory = "."s;
+    }
+    const int fd = open(directory.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (fd < 0) {
+        throw runtime_error("Cannot open "s + directory + ": "s + strerror(errno));
+    }
+    const int result = fsync(fd);
+    const int error = errno;
+    close(fd);
+    if (result != 0) {
+        throw runtime_error("Cannot sync "s + directory + ": "s + strerror(error));
+    }
+}
+
+int OpenForAppend(const string &path) {
+    const int fd = open(path.c_str(), O_RDWR | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        throw runtime_error("Cannot open "s + path + ": "s + strerror(errno));
+    }
+    return fd;
+}
+
+// Оставляет в файле только корректное начало; пустой файл получает заголовок
+void PrepareForAppend(int fd, const string &path) {
+    struct stat file_stat{};
+    if (fstat(fd, &file_stat) != 0) {
+        throw runtime_error("Cannot stat "s + path + ": "s + strerror(errno));
+    }
+    size_t valid_size = 0;
+    if (file_stat.st_size > 0) {
+        const MappedFile file(path);
+        valid_size = ScanRecords(file.GetData(), nullptr);
+    }
+    if (valid_size == static_cast<size_t>(file_stat.st_size) && valid_size > 0) {
+        return;
+    }
+    if (ftruncate(fd, static_cast<off_t>(valid_size)) != 0) {
+        throw runtime_error("Cannot truncate "s + path + ": "s + strerror(errno));
+    }
+    if (valid_size == 0) {
+        WriteAll(fd, WAL_MAGIC, path);
+    }
+    SyncFile(fd, path);
+    SyncDirectory(path);
+}
+
+struct ReplayDocument {
+    const WalRecord *record = nullptr;
+    vector<string_view> words;
+    optional<uint64_t> fingerprint;
+};
+
+// Разбор блока на слова в parser_threads потоков; документы с несколькими полями индексирует AddDocument
+vector<ReplayDocument> TokenizeBlock(const SearchServer &search_server, const vector<WalRecord> &records,
+                                     const vector<size_t> &adds, size_t first, size_t last, size_t parser_threads,
+                                     bool compute_fingerprints) {
+    vector<ReplayDocument> documents(last - first);
+    atomic<size_t> next{0};
+    const auto parse = [&] {
+        for (size_t i = next++; i < documents.size(); i = next++) {
+            ReplayDocument &document = documents[i];
+            document.record = &records[adds[first + i]];
+            if (document.record->IsPlainText()) {
+                document.words = search_server.Tokenize(document.record->fields.front().text);
+                if (compute_fingerprints) {
+                    document.fingerprint = ComputeTermSetFingerprint(document.words);
+                }
+            }
+        }
+    };
+    vector<thread> parsers;
+    for (size_t i = 1; i < min(parser_threads, documents.size()); ++i) {
+        parsers.emplace_back(parse);
+    }
+    parse();
+    for (auto &parser: parsers) {
+        parser.join();
+    }
+    return documents;
+}
+}
+
+WriteAheadLog::WriteAheadLog(const std::string &path, const WriteAheadLogOptions &options)
+        : path_(path), options_(options) {
+    fd_ = OpenForAppend(path_);
+    try {
+        PrepareForAppend(fd_, path_);
+    } catch (...) {
+        close(fd_);
+        throw;
+    }
+    writer_ = thread([this] {
+        WriteBatches();
+    });
+}
+
+WriteAheadLog::~WriteAheadLog() {
+    {
+        lock_guard guard(m_);
+        stopping_ = true;
+    }
+    pending_.notify_all();
+    writer_.join();
+    close(fd_);
+}
+
+uint64_t WriteAheadLog::LogAddDocument(int document_id, std::string_view document, DocumentStatus status,
+                                       const std::vector<int> &ratings) {
+    return Append(EncodeAddDocument(document_id, {{DEFAULT_FIELD, document}}, status, ratings));
+}
+
+uint64_t WriteAheadLog::LogAddDocument(int document_id, const std::vector<DocumentField> &fields,
+                                       DocumentStatus status, const std::vector<int> &ratings) {
+    return Append(EncodeAddDocument(document_id, fields, status, ratings));
+}
+
+uint64_t WriteAheadLog::LogRemoveDocument(int document_id) {
+    string payload;
+    Put(payload, static_cast<uint8_t>(WalRecordType::REMOVE_DOCUMENT));
+    Put(payload, static_cast<int32_t>(document_id));
+    return Append(EncodeRecord(payload));
+}
+
+uint64_t WriteAheadLog::Append(const std::string &record) {
+    unique_lock lock(m_);
+    written_.wait(lock, [this] {
+        return error_ || (!checkpointing_ && buffer_.size() < options_.max_pending_bytes);
+    });
+    if (error_) {
+        rethrow_exception(error_);
+    }
+    buffer_.append(record);
+    const uint64_t lsn = ++appended_lsn_;
+    lock.unlock();
+    pending_.notify_one();
+    return lsn;
+}
+
+void WriteAheadLog::WaitDurable(uint64_t lsn) {
+    unique_lock lock(m_);
+    written_.wait(lock, [this, lsn] {
+        return error_ || durable_lsn_ >= lsn;
+    });
+    if (durable_lsn_ < lsn) {
+        rethrow_exception(error_);
+    }
+}
+
+void WriteAheadLog::Sync() {
+    uint64_t lsn = 0;
+    {
+        lock_guard guard(m_);
+        lsn = appended_lsn_;
+    }
+    WaitDurable(lsn);
+}
+
+size_t WriteAheadLog::GetBatchCount() const {
+    lock_guard guard(m_);
+    return batch_count_;
+}
+
+void WriteAheadLog::WriteBatches() {
+    string batch;
+    unique_lock lock(m_);
+    while (true) {
+        pending_.wait(lock, [this] {
+            return stopping_ || !buffer_.empty();
+        });
+        if (buffer_.empty()) {
+            return;
+        }
+        if (options_.group_commit_delay.count() > 0) {
+            pending_.wait_for(lock, options_.group_commit_delay, [this] {
+                return stopping_ || buffer_.size() >= options_.max_pending_bytes;
+            });
+        }
+        // Пакет забирается целиком, а освободившийся буфер прошлого пакета переходит к добавляющим потокам
+        batch.clear();
+        batch.swap(buffer_);
+        const uint64_t batch_lsn = appended_lsn_;
+        const int fd = fd_;
+        writing_ = true;
+        lock.unlock();
+        written_.notify_all();
+
+        exception_ptr error;
+        try {
+            WriteAll(fd, batch, path_);
+            SyncFile(fd, path_);
+        } catch (...) {
+            error = current_exception();
+        }
+
+        lock.lock();
+        writing_ = false;
+        ++batch_count_;
+        if (error) {
+            // После неудачного fsync неизвестно, что попало на диск, поэтому журнал дальше не пишется
+            error_ = error;
+        } else {
+            durable_lsn_ = batch_lsn;
+        }
+        written_.notify_all();
+        if (error_) {
+            return;
+        }
+    }
+}
+
+void WriteAheadLog::Checkpoint() {
+    unique_lock lock(m_);
+    checkpointing_ = true;
+    written_.wait(lock, [this] {
+        return error_ || (!writing_ && buffer_.empty());
+    });
+    // Флаг снимается при любом исходе, иначе добавляющие потоки будут ждать вечно
+    const auto finish = [this](unique_lock<mutex> &held) {
+        checkpointing_ = false;
+        held.unlock();
+        written_.notify_all();
+    };
+    if (error_) {
+        finish(lock);
+        rethrow_exception(error_);
+    }
+
+    const string temporary_path = path_ + ".checkpoint"s;
+    try {
+        int new_fd = -1;
+        {
+            const MappedFile file(path_);
+            vector<WalRecord> records;
+            ScanRecords(file.GetData(), &records);
+
+            new_fd = open(temporary_path.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_APPEND | O_CLOEXEC, 0644);
+            if (new_fd < 0) {
+                throw runtime_error("Cannot open "s + temporary_path + ": "s + strerror(errno));
+            }
+            try {
+                // Последнее удаление сохраняется: журнал может применяться к индексу, загруженному из корпуса,
+                // и без него удалённый из корпуса документ вернулся бы
+                string data(WAL_MAGIC);
+                for (const size_t index: FindLastRecords(records)) {
+                    data.append(records[index].bytes);
+                }
+                WriteAll(new_fd, data, temporary_path);
+                SyncFile(new_fd, temporary_path);
+            } catch (...) {
+                close(new_fd);
+                throw;
+            }
+        }
+        if (rename(temporary_path.c_str(), path_.c_str()) != 0) {
+            const int error = errno;
+            close(new_fd);
+            throw runtime_error("Cannot replace "s + path_ + ": "s + strerror(error));
+        }
+        close(fd_);
+        fd_ = new_fd;
+        SyncDirectory(path_);
+    } catch (...) {
+        unlink(temporary_path.c_str());
+        finish(lock);
+        throw;
+    }
+    finish(lock);
+}
+
+WalReplayStats ReplayWriteAheadLog(SearchServer &search_server, const std::string &path, size_t parser_threads) {
+    WalReplayStats stats;
+    if (!filesystem::exists(path)) {
+        return stats;
+    }
+    const MappedFile file(path);
+    vector<WalRecord> records;
+    const size_t valid_size = ScanRecords(file.GetData(), &records);
+    stats.records = records.size();
+    stats.discarded_bytes = file.GetData().size() - valid_size;
+
+    // Ранние версии документов удаляются, а добавления собираются для разбора на слова
+    vector<size_t> adds;
+    for (const size_t index: FindLastRecords(records)) {
+        const WalRecord &record = records[index];
+        const int document_count = search_server.GetDocumentCount();
+        search_server.RemoveDocument(record.document_id);
+        if (record.type == WalRecordType::ADD_DOCUMENT) {
+            adds.push_back(index);
+        } else if (search_server.GetDocumentCount() < document_count) {
+            ++stats.documents_removed;
+        }
+    }
+
+    parser_threads = max<size_t>(1, parser_threads);
+    const bool compute_fingerprints = search_server.GetDuplicatePolicy() != DuplicatePolicy::ALLOW;
+    const auto tokenize = [&](size_t first) {
+        return TokenizeBlock(search_server, records, adds, first, min(first + REPLAY_BLOCK_SIZE, adds.size()),
+                             parser_threads, compute_fingerprints);
+    };
+    // Следующий блок разбирается, пока индексируется текущий
+    future<vector<ReplayDocument>> next_block;
+    vector<ReplayDocument> block = adds.empty() ? vector<ReplayDocument>{} : tokenize(0);
+    for (size_t first = 0; first < adds.size(); first += REPLAY_BLOCK_SIZE) {
+        if (first + REPLAY_BLOCK_SIZE < adds.size()) {
+            next_block = async(launch::async, tokenize, first + REPLAY_BLOCK_SIZE);
+        }
+        for (const ReplayDocument &document: block) {
+            const WalRecord &record = *document.record;
+            try {
+                if (record.IsPlainText()) {
+                    const auto duplicate = search_server.AddTokenizedDocument(
+                            record.document_id, document.words, record.status, record.ratings, document.fingerprint);
+                    if (!duplicate || search_server.GetDuplicatePolicy() == DuplicatePolicy::REPLACE) {
+                        ++stats.documents_added;
+                    }
+                } else {
+                    const int document_count = search_server.GetDocumentCount();
+                    search_server.AddDocument(record.document_id, record.fields, record.status, record.ratings);
+                    if (search_server.GetDocumentCount() > document_count
+                        || search_server.GetDuplicatePolicy() == DuplicatePolicy::REPLACE) {
+                        ++stats.documents_added;
+                    }
+                }
+            } catch (const invalid_argument &) {
+                ++stats.errors;
+            }
+        }
+        if (next_block.valid()) {
+            block = next_block.get();
+        }
+    }
+    search_server.RefreshInverseDocumentFreqs();
+    return stats;
+}
@@ -0,0 +1,110 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include "document.h"
+#include "search_server.h"
+
+struct WriteAheadLogOptions {
+    // Сколько поток записи ждёт после первой записи пакета, чтобы собрать в него больше изменений.
+    // При нуле пакет составляют изменения, пришедшие за время предыдущего fsync
+    std::chrono::microseconds group_commit_delay{0};
+    // Предел ещё не записанных байтов: при его превышении добавляющие потоки ждут записи
+    size_t max_pending_bytes = 64 * 1024 * 1024;
+};
+
+struct WalReplayStats {
+    size_t records = 0;
+    size_t documents_added = 0;
+    size_t documents_removed = 0;
+    // Документы, которые индекс отверг при повторе (например, дубликаты при DuplicatePolicy::REJECT)
+    size_t errors = 0;
+    // Байты после последней целой записи: хвост, оборванный при аварии, или повреждённые данные
+    size_t discarded_bytes = 0;
+};
+
+// Журнал изменений индекса: AddDocument и RemoveDocument, сделанные после последней контрольной точки,
+// дописываются в файл и переживают падение процесса.
+// Запись в журнале — длина, CRC-32 и тело. Изменения копятся в памяти, а отдельный поток пишет их пакетами
+// с одним fsync на пакет (group commit), поэтому тысячи документов в секунду не стоят тысяч синхронных записей.
+// Log* возвращают номер записи; изменение надёжно сохранено, когда WaitDurable(номер) вернул управление.
+// При открытии оборванный хвост файла отрезается, и новые записи продолжают последнюю целую.
+// Журнал не применяет изменения к индексу: вызывающий код меняет SearchServer сам (сначала индекс, который
+// проверяет аргументы, потом журнал) и подтверждает изменение клиенту после WaitDurable
+class WriteAheadLog {
+public:
+    explicit WriteAheadLog(const std::string &path, const WriteAheadLogOptions &options = {});
+
+    WriteAheadLog(const WriteAheadLog &) = delete;
+
+    WriteAheadLog &operator=(const WriteAheadLog &) = delete;
+
+    // Дописывает и синхронизирует всё накопленное
+    ~WriteAheadLog();
+
+    uint64_t LogAddDocument(int document_id, std::string_view document, DocumentStatus status,
+                            const std::vector<int> &ratings);
+
+    uint64_t LogAddDocument(int document_id, const std::vector<DocumentField> &fields, DocumentStatus status,
+                            const std::vector<int> &ratings);
+
+    uint64_t LogRemoveDocument(int document_id);
+
+    // Ждёт, пока запись с номером lsn и все предыдущие окажутся на диске. Ошибка записи пробрасывается
+    void WaitDurable(uint64_t lsn);
+
+    // Ждёт сохранения всех уже добавленных записей
+    void Sync();
+
+    // Контрольная точка: журнал переписывается так, что в нём остаётся только последнее изменение каждого
+    // документа — добавление живого или удаление, которое нужно, если журнал применяется поверх корпуса.
+    // Повтор после этого стоит столько же, сколько загрузка живых документов и удаление стёртых.
+    // Новый файл пишется рядом и атомарно заменяет старый; на время перезаписи Log* ждут
+    void Checkpoint();
+
+    [[nodiscard]] const std::string &GetPath() const {
+        return path_;
+    }
+
+    [[nodiscard]] size_t GetBatchCount() const;
+
+private:
+    const std::string path_;
+    const WriteAheadLogOptions options_;
+    int fd_ = -1;
+
+    mutable std::mutex m_;
+    std::condition_variable pending_;
+    std::condition_variable written_;
+    std::string buffer_;
+    uint64_t appended_lsn_ = 0;
+    uint64_t durable_lsn_ = 0;
+    // Поток записи держит пакет вне мьютекса; контрольная точка ждёт, пока он закончит
+    bool writing_ = false;
+    bool checkpointing_ = false;
+    bool stopping_ = false;
+    size_t batch_count_ = 0;
+    std::exception_ptr error_;
+    std::thread writer_;
+
+    uint64_t Append(const std::string &record);
+
+    void WriteBatches();
+};
+
+// Применяет журнал к индексу: пустому, если всё состояние хранится в журнале, или загруженному из корпуса.
+// Записи проверяются по CRC до первой повреждённой. Для каждого документа учитывается только последнее
+// изменение: ранние версии удаляются из индекса, а последние добавления разбираются на слова параллельно
+// (parser_threads потоков) и добавляются через AddTokenizedDocument в порядке журнала, как при загрузке корпуса.
+// Отсутствующий файл — пустой журнал
+WalReplayStats ReplayWriteAheadLog(SearchServer &search_server, const std::string &path,
+                                   size_t parser_threads = std::max(1u, std::thread::hardware_concurrency()));